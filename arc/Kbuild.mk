@@ -1 +1,4 @@
 obj-y += main.o
+obj-y += rawdata_collector.o
+obj-y += rawdata_packer.o
+obj-y += rawdata_features.o
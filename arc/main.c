@@ -36,6 +36,8 @@
 
 #include "cfw/cfw.h"
 
+#include "rawdata_collector.h"
+
 static xloop_t loop;
 
 void main(void)
@@ -48,5 +50,8 @@ void main(void)
 	pr_info(LOG_MODULE_MAIN, "CFW init done");
 
 	xloop_init_from_queue(&loop, queue);
+
+	rawdata_collector_init(queue, &loop);
+
 	xloop_run(&loop);
 }
@@ -0,0 +1,515 @@
+/*
+ * Copyright (c) 2016, Intel Corporation. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ * this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ * this list of conditions and the following disclaimer in the documentation
+ * and/or other materials provided with the distribution.
+ *
+ * 3. Neither the name of the copyright holder nor the names of its contributors
+ * may be used to endorse or promote products derived from this software without
+ * specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <string.h>
+
+#include "util/misc.h"
+#include "os/os.h"
+#include "infra/log.h"
+#include "infra/time.h"
+#include "infra/xloop.h"
+
+#include "cfw/cfw.h"
+#include "cfw/cfw_service.h"
+
+#include "rawdata_collector.h"
+#include "rawdata_packer.h"
+#include "rawdata_features.h"
+
+/* Period over which the sampling rate of a sensor is measured in ms */
+#define RATE_MEASURE_PERIOD     1000
+/* A new stream info is stored if the rate changes by more than 1/100 */
+#define RATE_CHANGE_THRESHOLD   100
+
+struct subscription {
+	sensor_service_t handle;
+	/* Requested frequency in Hz */
+	uint16_t frequency;
+	uint16_t reporting_interval;
+	/* Sampling interval in ms */
+	uint16_t sampling_interval;
+	/* Maximum time covered by a batch */
+	uint16_t batch_interval;
+	/* Features computed instead of forwarding the samples */
+	struct rawdata_feature_window features;
+	/* Sampling rate measurement: samples received since rate_start */
+	uint32_t rate_start;
+	uint32_t rate_samples;
+	/* Rate of the last stream info in mHz, 0 before the first report */
+	uint32_t rate;
+	/* Request waiting for the sensor service response */
+	struct cfw_message *pending_req;
+	/* Samples received, to decimate the throttled samples */
+	uint32_t nb_samples;
+};
+
+static void client_connected(conn_handle_t *instance);
+static void client_disconnected(conn_handle_t *instance);
+
+static service_t collector_service = {
+	.service_id = RAWDATA_COLLECTOR_SERVICE_ID,
+	.client_connected = client_connected,
+	.client_disconnected = client_disconnected,
+};
+
+/* Sensors client */
+static cfw_client_t *client = NULL;
+static cfw_service_conn_t *sensor_service_conn = NULL;
+
+/* Connection of the raw data collection, a single one is supported */
+static conn_handle_t *collector_conn = NULL;
+
+static struct subscription subscriptions[RAWDATA_COLLECTOR_MAX_SUBSCRIPTIONS];
+
+/* Only 1 sample out of 1 << throttle_shift is kept */
+static uint8_t throttle_shift = 0;
+
+/* Records waiting to be sent */
+static struct batch {
+	uint8_t records[RAWDATA_COLLECTOR_BATCH_SIZE];
+	uint16_t length;
+	uint8_t nb_records;
+	/* Reports packed since the previous batch */
+	uint8_t nb_reports;
+	uint32_t first_timestamp;
+	/* Smallest batch interval of the subscriptions */
+	uint16_t interval;
+} batch;
+
+/* A batch event must fit in a block of the largest pool */
+STATIC_ASSERT(sizeof(struct rawdata_collector_batch_evt) +
+	      RAWDATA_COLLECTOR_BATCH_SIZE <= RAWDATA_COLLECTOR_BATCH_BLOCK);
+
+/* The pending records are flushed once the batch interval elapsed, even if
+ * no later record closes the batch */
+static xloop_t *collector_loop = NULL;
+static T_TIMER flush_timer = NULL;
+static bool flush_armed = false;
+
+static struct subscription *find_subscription(sensor_service_t handle)
+{
+	uint8_t i;
+
+	for (i = 0; i < RAWDATA_COLLECTOR_MAX_SUBSCRIPTIONS; i++)
+		if (subscriptions[i].handle == handle)
+			return &subscriptions[i];
+	return NULL;
+}
+
+static bool has_subscriptions(void)
+{
+	uint8_t i;
+
+	for (i = 0; i < RAWDATA_COLLECTOR_MAX_SUBSCRIPTIONS; i++)
+		if (subscriptions[i].handle)
+			return true;
+	return false;
+}
+
+static void update_batch_interval(void)
+{
+	uint16_t sampling_interval = UINT16_MAX;
+	uint8_t i;
+
+	batch.interval = UINT16_MAX;
+	for (i = 0; i < RAWDATA_COLLECTOR_MAX_SUBSCRIPTIONS; i++)
+		if (subscriptions[i].handle) {
+			batch.interval = MIN(batch.interval,
+					     subscriptions[i].batch_interval);
+			sampling_interval = MIN(sampling_interval,
+						subscriptions[i].
+						sampling_interval);
+		}
+	rawdata_packer_set_interval(sampling_interval);
+}
+
+static uint8_t sample_size(uint8_t sensor_type)
+{
+	switch (sensor_type) {
+	case SENSOR_ACCELEROMETER:
+		return RAWDATA_ACCEL_SAMPLE_SIZE;
+	case SENSOR_GYROSCOPE:
+		return RAWDATA_GYRO_SAMPLE_SIZE;
+	default:
+		return 0;
+	}
+}
+
+static void store_stream_info(struct subscription *sub, uint32_t timestamp)
+{
+	struct rawdata_stream_info info = {
+		.sensor_type = GET_SENSOR_TYPE(sub->handle),
+		.frequency = sub->frequency,
+		.rate = sub->rate,
+		.reporting_interval = sub->reporting_interval,
+	};
+
+	rawdata_packer_add(RAWDATA_STREAM_INFO_TYPE, timestamp,
+			   (const uint8_t *)&info, sizeof(info), 0, 0);
+}
+
+/* Measure the real sampling rate of a sensor, and store it in a stream info
+ * when the stream starts or when the rate changes */
+static void measure_rate(struct subscription *sub, uint32_t timestamp,
+			 uint16_t nb_samples)
+{
+	uint32_t elapsed;
+	uint32_t rate;
+
+	if (!sub->rate) {
+		/* The requested rate is used until it is measured */
+		sub->rate = sub->frequency * 1000;
+		sub->rate_start = timestamp;
+		sub->rate_samples = 0;
+		store_stream_info(sub, timestamp);
+		return;
+	}
+
+	sub->rate_samples += nb_samples;
+	elapsed = timestamp - sub->rate_start;
+	if (elapsed < RATE_MEASURE_PERIOD)
+		return;
+
+	rate = (uint64_t)sub->rate_samples * 1000000 / elapsed;
+	sub->rate_start = timestamp;
+	sub->rate_samples = 0;
+	if ((rate > sub->rate ? rate - sub->rate : sub->rate - rate) *
+	    RATE_CHANGE_THRESHOLD > sub->rate) {
+		sub->rate = rate;
+		store_stream_info(sub, timestamp);
+	}
+}
+
+/* Keep 1 sample out of 1 << throttle_shift in place, the timestamp is updated
+ * to the one of the last sample kept. Return the new length */
+static uint16_t decimate(struct subscription *sub, uint8_t *data,
+			 uint16_t length, uint8_t size, uint32_t *timestamp)
+{
+	uint16_t nb_samples = length / size;
+	uint16_t kept = 0;
+	uint16_t last = 0;
+	uint16_t i;
+
+	for (i = 0; i < nb_samples; i++) {
+		if (sub->nb_samples++ & ((1 << throttle_shift) - 1))
+			continue;
+		memmove(&data[kept * size], &data[i * size], size);
+		kept++;
+		last = i;
+	}
+	*timestamp -= (nb_samples - 1 - last) * sub->sampling_interval;
+	return kept * size;
+}
+
+static void send_rsp(struct cfw_message *req, int msg_id, int status)
+{
+	struct rawdata_collector_rsp *rsp =
+		(struct rawdata_collector_rsp *)cfw_alloc_rsp_msg(
+			req, msg_id, sizeof(*rsp));
+
+	rsp->status = status;
+	cfw_send_message(rsp);
+	cfw_msg_free(req);
+}
+
+/* Send the pending records in a single event */
+static void flush_batch(void)
+{
+	struct rawdata_collector_batch_evt *evt;
+
+	if (!batch.nb_records)
+		return;
+
+	if (collector_conn) {
+		evt = (struct rawdata_collector_batch_evt *)cfw_alloc_evt_msg(
+			&collector_service, MSG_ID_RAWDATA_COLLECTOR_BATCH_EVT,
+			sizeof(*evt) + batch.length);
+		/* Only the raw data collection gets the records */
+		CFW_MESSAGE_DST(&evt->header) = collector_conn->client_port;
+		evt->header.conn = collector_conn->client_handle;
+		evt->nb_reports = batch.nb_reports;
+		evt->nb_records = batch.nb_records;
+		evt->length = batch.length;
+		memcpy(evt->records, batch.records, batch.length);
+		cfw_send_message(evt);
+	}
+	batch.nb_reports = 0;
+	batch.nb_records = 0;
+	batch.length = 0;
+
+	/* Armed again by the next report */
+	if (flush_armed) {
+		timer_stop(flush_timer, NULL);
+		flush_armed = false;
+	}
+}
+
+/* Finish the current record and send all the pending ones */
+static void flush_all(void)
+{
+	rawdata_packer_flush();
+	flush_batch();
+}
+
+static int flush_job(void *param)
+{
+	flush_armed = false;
+	flush_all();
+	return 0;
+}
+
+static void flush_timer_cb(void *param)
+{
+	xloop_post_func(collector_loop, flush_job, NULL);
+}
+
+/* Flush the pending data at the end of the batch interval, counted from the
+ * first record of the batch or from now if it is still being packed */
+static void arm_flush(void)
+{
+	int32_t delay = batch.interval;
+
+	if (flush_armed || !flush_timer)
+		return;
+	if (batch.nb_records)
+		delay = (int32_t)(batch.first_timestamp + batch.interval -
+				  (uint32_t)get_uptime_ms());
+	flush_armed = true;
+	timer_start(flush_timer, MAX(delay, 1), NULL);
+}
+
+/* Called by the packer with each finished record */
+static void add_record(const struct stored_data *record)
+{
+	uint16_t size = sizeof(uint8_t) + record->datasize;
+
+	/* Close the batch if the record does not fit or if it is past the
+	 * batch interval */
+	if (batch.nb_records &&
+	    ((batch.length + size > RAWDATA_COLLECTOR_BATCH_SIZE) ||
+	     (record->timestamp >= batch.first_timestamp + batch.interval)))
+		flush_batch();
+
+	if (!batch.nb_records)
+		batch.first_timestamp = record->timestamp;
+
+	batch.records[batch.length] = record->datasize;
+	memcpy(&batch.records[batch.length + 1], record, record->datasize);
+	batch.length += size;
+	batch.nb_records++;
+}
+
+static void handle_subscribe(struct rawdata_collector_subscribe_req *req)
+{
+	struct subscription *sub = find_subscription(NULL);
+	uint8_t data_type = ACCEL_DATA;
+
+	if (!sensor_service_conn || !sub || find_subscription(req->handle)) {
+		send_rsp(&req->header, MSG_ID_RAWDATA_COLLECTOR_SUBSCRIBE_RSP,
+			 -1);
+		return;
+	}
+
+	collector_conn = req->header.conn;
+	sub->handle = req->handle;
+	sub->frequency = req->frequency;
+	sub->reporting_interval = req->reporting_interval;
+	sub->sampling_interval = 1000 / MAX(req->frequency, 1);
+	sub->rate = 0;
+	sub->batch_interval = req->batch_interval;
+	/* Only the 3 axis sensors have features */
+	rawdata_features_init(&sub->features, GET_SENSOR_TYPE(req->handle),
+			      sample_size(GET_SENSOR_TYPE(req->handle)) ?
+			      req->feature_window : 0);
+	sub->pending_req = &req->header;
+	sub->nb_samples = 0;
+	update_batch_interval();
+
+	/* The request is answered on the sensor service response */
+	sensor_service_subscribe_data(sensor_service_conn, sub, req->handle,
+				      &data_type, 1, req->frequency,
+				      req->reporting_interval);
+}
+
+static void handle_unsubscribe(struct rawdata_collector_unsubscribe_req *req)
+{
+	struct subscription *sub = find_subscription(req->handle);
+	uint8_t data_type = ACCEL_DATA;
+
+	if (!sub || !req->handle || sub->pending_req) {
+		send_rsp(&req->header,
+			 MSG_ID_RAWDATA_COLLECTOR_UNSUBSCRIBE_RSP, -1);
+		return;
+	}
+
+	/* Do not keep reports of a stopped sensor */
+	rawdata_features_flush(&sub->features);
+	flush_all();
+	sub->pending_req = &req->header;
+	sensor_service_unsubscribe_data(sensor_service_conn, sub, req->handle,
+					&data_type, 1);
+}
+
+static void handle_throttle(struct rawdata_collector_throttle_req *req)
+{
+	throttle_shift = MIN(req->shift, RAWDATA_COLLECTOR_MAX_THROTTLE);
+	send_rsp(&req->header, MSG_ID_RAWDATA_COLLECTOR_THROTTLE_RSP, 0);
+}
+
+static void handle_request(struct cfw_message *msg, void *param)
+{
+	switch (CFW_MESSAGE_ID(msg)) {
+	case MSG_ID_RAWDATA_COLLECTOR_SUBSCRIBE_REQ:
+		handle_subscribe((struct rawdata_collector_subscribe_req *)msg);
+		break;
+	case MSG_ID_RAWDATA_COLLECTOR_UNSUBSCRIBE_REQ:
+		handle_unsubscribe(
+			(struct rawdata_collector_unsubscribe_req *)msg);
+		break;
+	case MSG_ID_RAWDATA_COLLECTOR_THROTTLE_REQ:
+		handle_throttle((struct rawdata_collector_throttle_req *)msg);
+		break;
+	default:
+		cfw_msg_free(msg);
+		break;
+	}
+}
+
+static void handle_sensor_msg(struct cfw_message *msg, void *data)
+{
+	struct subscription *sub = CFW_MESSAGE_PRIV(msg);
+	uint8_t status;
+
+	switch (CFW_MESSAGE_ID(msg)) {
+	case MSG_ID_SENSOR_SERVICE_SUBSCRIBE_DATA_RSP:
+		status = ((sensor_service_message_general_rsp_t *)msg)->status;
+		if (sub && sub->pending_req) {
+			send_rsp(sub->pending_req,
+				 MSG_ID_RAWDATA_COLLECTOR_SUBSCRIBE_RSP,
+				 status == RESP_SUCCESS ? 0 : -1);
+			sub->pending_req = NULL;
+			if (status != RESP_SUCCESS) {
+				sub->handle = NULL;
+				update_batch_interval();
+			}
+		}
+		break;
+	case MSG_ID_SENSOR_SERVICE_UNSUBSCRIBE_DATA_RSP:
+		if (sub) {
+			if (sub->pending_req)
+				send_rsp(sub->pending_req,
+					 MSG_ID_RAWDATA_COLLECTOR_UNSUBSCRIBE_RSP,
+					 0);
+			sub->pending_req = NULL;
+			sub->handle = NULL;
+			update_batch_interval();
+			/* The next session starts at full rate */
+			if (!has_subscriptions())
+				throttle_shift = 0;
+		}
+		break;
+	case MSG_ID_SENSOR_SERVICE_SUBSCRIBE_DATA_EVT:;
+		sensor_service_subscribe_data_event_t *p_evt =
+			(sensor_service_subscribe_data_event_t *)msg;
+		sensor_service_sensor_data_header_t *p_data_header =
+			&p_evt->sensor_data_header;
+		uint8_t type = GET_SENSOR_TYPE(p_evt->handle);
+		uint8_t size = sample_size(type);
+		uint32_t timestamp = p_data_header->timestamp;
+		uint16_t length = p_data_header->data_length;
+
+		sub = find_subscription(p_evt->handle);
+		if (!sub)
+			break;
+		batch.nb_reports++;
+		if (throttle_shift && size && !sub->features.duration) {
+			length = decimate(sub, p_data_header->data, length,
+					  size, &timestamp);
+			if (!length)
+				break;
+		}
+		measure_rate(sub, timestamp, size ? length / size : 1);
+		if (sub->features.duration)
+			rawdata_features_add(&sub->features, timestamp,
+					     p_data_header->data, length, size,
+					     sub->sampling_interval);
+		else
+			rawdata_packer_add(type, timestamp,
+					   p_data_header->data, length, size,
+					   sub->sampling_interval <<
+					   (size ? throttle_shift : 0));
+		arm_flush();
+		break;
+	default: break;
+	}
+	cfw_msg_free(msg);
+}
+
+static void client_connected(conn_handle_t *instance)
+{
+}
+
+static void client_disconnected(conn_handle_t *instance)
+{
+	uint8_t data_type = ACCEL_DATA;
+	uint8_t i;
+
+	if (instance != collector_conn)
+		return;
+
+	/* Release the sensors of the raw data collection */
+	collector_conn = NULL;
+	flush_all();
+	for (i = 0; i < RAWDATA_COLLECTOR_MAX_SUBSCRIPTIONS; i++)
+		if (subscriptions[i].handle && !subscriptions[i].pending_req)
+			sensor_service_unsubscribe_data(
+				sensor_service_conn, &subscriptions[i],
+				subscriptions[i].handle, &data_type, 1);
+}
+
+static void service_connection_cb(cfw_service_conn_t *handle, void *param)
+{
+	sensor_service_conn = handle;
+}
+
+void rawdata_collector_init(T_QUEUE queue, xloop_t *loop)
+{
+	client = cfw_client_init(queue, handle_sensor_msg, NULL);
+	rawdata_packer_init(add_record);
+
+	collector_loop = loop;
+	flush_timer = timer_create(flush_timer_cb, NULL, 1, false, false, NULL);
+
+	/* Open the sensor service */
+	cfw_open_service_helper(client, ARC_SC_SVC_ID,
+				service_connection_cb, NULL);
+
+	cfw_register_service(queue, &collector_service, handle_request, NULL);
+}
@@ -0,0 +1,159 @@
+/*
+ * Copyright (c) 2016, Intel Corporation. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ * this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ * this list of conditions and the following disclaimer in the documentation
+ * and/or other materials provided with the distribution.
+ *
+ * 3. Neither the name of the copyright holder nor the names of its contributors
+ * may be used to endorse or promote products derived from this software without
+ * specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <string.h>
+
+#include "util/misc.h"
+
+#include "rawdata_features.h"
+#include "rawdata_packer.h"
+
+/* Read a sample axis, samples are 3 int16_t or 3 int32_t */
+static int32_t get_axis(const uint8_t *sample, uint8_t sample_size,
+			uint8_t axis)
+{
+	int16_t val16;
+	int32_t val32;
+
+	if (sample_size == 3 * sizeof(int16_t)) {
+		memcpy(&val16, &sample[axis * sizeof(val16)], sizeof(val16));
+		return val16;
+	}
+	memcpy(&val32, &sample[axis * sizeof(val32)], sizeof(val32));
+	return val32;
+}
+
+static uint32_t saturate(uint64_t val)
+{
+	return val > UINT32_MAX ? UINT32_MAX : val;
+}
+
+static void reset_window(struct rawdata_feature_window *window)
+{
+	uint8_t i;
+
+	window->nb_samples = 0;
+	for (i = 0; i < 3; i++) {
+		window->sum[i] = 0;
+		window->sum_sq[i] = 0;
+		window->min[i] = INT32_MAX;
+		window->max[i] = INT32_MIN;
+		window->sign[i] = 0;
+		window->crossings[i] = 0;
+	}
+}
+
+void rawdata_features_init(struct rawdata_feature_window *window,
+			   uint8_t sensor_type, uint16_t duration)
+{
+	memset(window, 0, sizeof(*window));
+	window->sensor_type = sensor_type;
+	window->duration = duration;
+	reset_window(window);
+}
+
+void rawdata_features_flush(struct rawdata_feature_window *window)
+{
+	struct rawdata_features features;
+	int64_t mean;
+	uint64_t energy;
+	uint8_t i;
+
+	if (!window->nb_samples)
+		return;
+
+	features.nb_samples = window->nb_samples;
+	for (i = 0; i < 3; i++) {
+		mean = window->sum[i] / window->nb_samples;
+		energy = window->sum_sq[i] / window->nb_samples;
+		features.axis[i].mean = mean;
+		/* Var(x) = E(x^2) - E(x)^2 */
+		features.axis[i].variance =
+			energy > (uint64_t)(mean * mean) ?
+			saturate(energy - mean * mean) : 0;
+		features.axis[i].energy = saturate(energy);
+		features.axis[i].min = window->min[i];
+		features.axis[i].max = window->max[i];
+		features.axis[i].zero_crossings = window->crossings[i];
+		window->ref[i] = mean;
+	}
+
+	rawdata_packer_add(RAWDATA_FEATURES_TYPE(window->sensor_type),
+			   window->last, (const uint8_t *)&features,
+			   sizeof(features), 0, 0);
+	reset_window(window);
+}
+
+static void add_sample(struct rawdata_feature_window *window,
+		       uint32_t timestamp, const uint8_t *sample,
+		       uint8_t sample_size)
+{
+	int32_t val;
+	int8_t sign;
+	uint8_t i;
+
+	if (window->nb_samples &&
+	    (timestamp >= window->start + window->duration))
+		rawdata_features_flush(window);
+
+	if (!window->nb_samples)
+		window->start = timestamp;
+	window->last = timestamp;
+	window->nb_samples++;
+
+	for (i = 0; i < 3; i++) {
+		val = get_axis(sample, sample_size, i);
+		window->sum[i] += val;
+		window->sum_sq[i] += (int64_t)val * val;
+		window->min[i] = MIN(window->min[i], val);
+		window->max[i] = MAX(window->max[i], val);
+
+		sign = val > window->ref[i] ? 1 : (val < window->ref[i] ? -1 : 0);
+		if (sign && window->sign[i] && sign != window->sign[i])
+			window->crossings[i]++;
+		if (sign)
+			window->sign[i] = sign;
+	}
+}
+
+void rawdata_features_add(struct rawdata_feature_window *window,
+			  uint32_t timestamp, const uint8_t *data,
+			  uint16_t data_len, uint8_t sample_size,
+			  uint16_t sampling_interval)
+{
+	uint16_t nb_samples = data_len / sample_size;
+	uint16_t i;
+
+	/* The report timestamp is the one of its last sample */
+	for (i = 0; i < nb_samples; i++)
+		add_sample(window,
+			   timestamp - (nb_samples - 1 - i) * sampling_interval,
+			   &data[i * sample_size], sample_size);
+}
@@ -0,0 +1,88 @@
+/*
+ * Copyright (c) 2016, Intel Corporation. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ * this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ * this list of conditions and the following disclaimer in the documentation
+ * and/or other materials provided with the distribution.
+ *
+ * 3. Neither the name of the copyright holder nor the names of its contributors
+ * may be used to endorse or promote products derived from this software without
+ * specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef __RAWDATA_FEATURES_H__
+#define __RAWDATA_FEATURES_H__
+
+#include <stdint.h>
+
+#include "rawdata_record.h"
+
+/* Features of a 3 axis sensor being computed over a window */
+struct rawdata_feature_window {
+	uint8_t sensor_type;
+	/* Window duration in ms, 0 if the features are not computed */
+	uint16_t duration;
+	/* Timestamps of the first and last samples of the window */
+	uint32_t start;
+	uint32_t last;
+	uint16_t nb_samples;
+	int64_t sum[3];
+	uint64_t sum_sq[3];
+	int32_t min[3];
+	int32_t max[3];
+	/* Mean of the previous window, reference of the zero crossings */
+	int32_t ref[3];
+	int8_t sign[3];
+	uint16_t crossings[3];
+};
+
+/** Start computing the features of a sensor.
+ *
+ * @param window features of the sensor
+ * @param sensor_type sensor type
+ * @param duration window duration in ms
+ */
+void rawdata_features_init(struct rawdata_feature_window *window,
+			   uint8_t sensor_type, uint16_t duration);
+
+/** Add the samples of a sensor report to the window.
+ * Once a window is complete, its features are packed in a record as a
+ * RAWDATA_FEATURES_TYPE TLV.
+ *
+ * @param window features of the sensor
+ * @param timestamp timestamp of the last sample of the report in ms
+ * @param data sensor samples
+ * @param data_len length of the sensor samples
+ * @param sample_size size of a sample: 3 int16_t or 3 int32_t
+ * @param sampling_interval sampling interval in ms
+ */
+void rawdata_features_add(struct rawdata_feature_window *window,
+			  uint32_t timestamp, const uint8_t *data,
+			  uint16_t data_len, uint8_t sample_size,
+			  uint16_t sampling_interval);
+
+/** Pack the features of the current window, if any.
+ *
+ * @param window features of the sensor
+ */
+void rawdata_features_flush(struct rawdata_feature_window *window);
+
+#endif
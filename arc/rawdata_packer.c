@@ -0,0 +1,123 @@
+/*
+ * Copyright (c) 2016, Intel Corporation. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ * this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ * this list of conditions and the following disclaimer in the documentation
+ * and/or other materials provided with the distribution.
+ *
+ * 3. Neither the name of the copyright holder nor the names of its contributors
+ * may be used to endorse or promote products derived from this software without
+ * specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <stddef.h>
+#include <string.h>
+
+#include "util/misc.h"
+#include "infra/log.h"
+
+#include "rawdata_packer.h"
+
+static void (*record_done)(const struct stored_data *record) = NULL;
+static uint16_t sampling_interval = 0;
+
+static struct stored_data record;
+static uint8_t data_index = 0;
+
+void rawdata_packer_init(void (*record_cb)(const struct stored_data *record))
+{
+	record_done = record_cb;
+	data_index = 0;
+}
+
+void rawdata_packer_set_interval(uint16_t interval)
+{
+	sampling_interval = interval;
+}
+
+void rawdata_packer_flush(void)
+{
+	if (!data_index)
+		return;
+
+	/* Actual size = timestamp + valid portion of data array */
+	record.datasize = offsetof(struct stored_data, data) + data_index;
+	data_index = 0;
+	if (record_done)
+		record_done(&record);
+}
+
+void rawdata_packer_add(uint8_t type, uint32_t timestamp, const uint8_t *data,
+			uint16_t data_len, uint8_t sample_size,
+			uint16_t sample_interval)
+{
+	uint32_t chunk_timestamp;
+	uint16_t room;
+	uint16_t chunk;
+
+	if (!sample_size || sample_size > data_len)
+		sample_size = data_len;
+	if (RAWDATA_RECORD_TLV_HEADER + sample_size > sizeof(record.data)) {
+		pr_error(LOG_MODULE_MAIN, "Report too big [%d]", data_len);
+		return;
+	}
+
+	while (data_len) {
+		/* Copy as many whole samples as the record can hold */
+		room = sizeof(record.data) - data_index;
+		room = room > RAWDATA_RECORD_TLV_HEADER ?
+		       room - RAWDATA_RECORD_TLV_HEADER : 0;
+		if (data_len > room && data_len <= sizeof(record.data) -
+		    RAWDATA_RECORD_TLV_HEADER)
+			/* Keep the reports that fit in a record in one piece */
+			chunk = 0;
+		else
+			chunk = MIN(data_len, room - room % sample_size);
+
+		/* The report timestamp is the one of its last sample */
+		chunk_timestamp = timestamp - (data_len - chunk) / sample_size *
+				  sample_interval;
+
+		/* if timestamp change or there is not enough space to set
+		 * sensor data: finish the record and start a new one */
+		if (!chunk || (data_index && (chunk_timestamp >
+					      record.timestamp +
+					      (sampling_interval / 2)))) {
+			rawdata_packer_flush();
+			continue;
+		}
+
+		/* data_index is null when it is the first element */
+		if (!data_index)
+			record.timestamp = chunk_timestamp;
+
+		/* Complete data header */
+		record.data[data_index] = type;
+		record.data[data_index + 1] = chunk;
+		/* Copy sensor data */
+		memcpy(&record.data[data_index + RAWDATA_RECORD_TLV_HEADER],
+		       data, chunk);
+		data_index += RAWDATA_RECORD_TLV_HEADER + chunk;
+
+		data += chunk;
+		data_len -= chunk;
+	}
+}
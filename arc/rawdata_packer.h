@@ -0,0 +1,74 @@
+/*
+ * Copyright (c) 2016, Intel Corporation. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ * this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ * this list of conditions and the following disclaimer in the documentation
+ * and/or other materials provided with the distribution.
+ *
+ * 3. Neither the name of the copyright holder nor the names of its contributors
+ * may be used to endorse or promote products derived from this software without
+ * specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef __RAWDATA_PACKER_H__
+#define __RAWDATA_PACKER_H__
+
+#include <stdint.h>
+
+#include "rawdata_record.h"
+
+/** Raw data packer init.
+ * The packer groups the sensor reports sharing a timestamp in storage
+ * records, the same way the records were built by the Quark.
+ *
+ * @param record_cb callback called with each finished record
+ */
+void rawdata_packer_init(void (*record_cb)(const struct stored_data *record));
+
+/** Set the sampling interval of the packed sensors.
+ * Reports received within half of this interval after the record timestamp
+ * are packed in the same record.
+ *
+ * @param interval sampling interval in ms
+ */
+void rawdata_packer_set_interval(uint16_t interval);
+
+/** Pack a sensor report.
+ * The current record is finished if the report does not fit or if it is
+ * past the record interval. Reports bigger than a record, like the ones read
+ * from a hardware FIFO, are split on sample boundaries; the timestamp of
+ * each part is derived from the sampling interval of the sensor.
+ *
+ * @param type sensor type
+ * @param timestamp timestamp of the last sample of the report in ms
+ * @param data sensor data
+ * @param data_len length of the sensor data
+ * @param sample_size size of a sample, 0 if the report can not be split
+ * @param sample_interval sampling interval of the sensor in ms
+ */
+void rawdata_packer_add(uint8_t type, uint32_t timestamp, const uint8_t *data,
+			uint16_t data_len, uint8_t sample_size,
+			uint16_t sample_interval);
+
+/** Finish the current record, if any. */
+void rawdata_packer_flush(void);
+
+#endif
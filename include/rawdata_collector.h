@@ -0,0 +1,180 @@
+/*
+ * Copyright (c) 2016, Intel Corporation. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ * this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ * this list of conditions and the following disclaimer in the documentation
+ * and/or other materials provided with the distribution.
+ *
+ * 3. Neither the name of the copyright holder nor the names of its contributors
+ * may be used to endorse or promote products derived from this software without
+ * specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef __RAWDATA_COLLECTOR_H__
+#define __RAWDATA_COLLECTOR_H__
+
+#include "cfw/cfw.h"
+#include "infra/xloop.h"
+#include "services/sensor_service/sensor_service.h"
+
+#include "rawdata_record.h"
+
+/**
+ * Raw data collector service.
+ *
+ * This service runs on the sensor core next to the sensor service. It
+ * subscribes to the sensors on behalf of the raw data collection, packs
+ * their reports in storage records and forwards the finished records in
+ * batches, so that the Quark only has to store them.
+ */
+
+/* Project specific service, above the ids used by the framework services */
+#define RAWDATA_COLLECTOR_SERVICE_ID            40
+
+#define MSG_ID_RAWDATA_COLLECTOR_BASE           0xA000
+#define MSG_ID_RAWDATA_COLLECTOR_RSP_BASE       (MSG_ID_RAWDATA_COLLECTOR_BASE + 0x40)
+#define MSG_ID_RAWDATA_COLLECTOR_EVT_BASE       (MSG_ID_RAWDATA_COLLECTOR_BASE + 0x80)
+
+/* Requests */
+#define MSG_ID_RAWDATA_COLLECTOR_SUBSCRIBE_REQ     (MSG_ID_RAWDATA_COLLECTOR_BASE + 1)
+#define MSG_ID_RAWDATA_COLLECTOR_UNSUBSCRIBE_REQ   (MSG_ID_RAWDATA_COLLECTOR_BASE + 2)
+#define MSG_ID_RAWDATA_COLLECTOR_THROTTLE_REQ      (MSG_ID_RAWDATA_COLLECTOR_BASE + 3)
+
+/* Responses */
+#define MSG_ID_RAWDATA_COLLECTOR_SUBSCRIBE_RSP     (MSG_ID_RAWDATA_COLLECTOR_RSP_BASE + 1)
+#define MSG_ID_RAWDATA_COLLECTOR_UNSUBSCRIBE_RSP   (MSG_ID_RAWDATA_COLLECTOR_RSP_BASE + 2)
+#define MSG_ID_RAWDATA_COLLECTOR_THROTTLE_RSP      (MSG_ID_RAWDATA_COLLECTOR_RSP_BASE + 3)
+
+/* Events */
+#define MSG_ID_RAWDATA_COLLECTOR_BATCH_EVT         (MSG_ID_RAWDATA_COLLECTOR_EVT_BASE + 1)
+
+/* Maximum number of sensors subscribed at the same time */
+#define RAWDATA_COLLECTOR_MAX_SUBSCRIPTIONS     4
+
+/* Size of the largest memory pool blocks of the sensor core, from which the
+ * batch events are allocated */
+#define RAWDATA_COLLECTOR_BATCH_BLOCK           512
+
+/* Maximum number of full records carried by a batch event */
+#define RAWDATA_COLLECTOR_BATCH_RECORDS         3
+
+/* Maximum size of the records carried by a batch event, each record is
+ * preceded by its size */
+#define RAWDATA_COLLECTOR_BATCH_SIZE \
+	(RAWDATA_COLLECTOR_BATCH_RECORDS * (sizeof(uint8_t) + RAWDATA_RECORD_SIZE))
+
+/* Maximum sampling rate division of a throttle request, as a shift */
+#define RAWDATA_COLLECTOR_MAX_THROTTLE          3
+
+struct rawdata_collector_subscribe_req {
+	struct cfw_message header;
+	sensor_service_t handle;
+	uint16_t frequency;
+	uint16_t reporting_interval;
+	/* Maximum time in ms covered by the reports of a batch */
+	uint16_t batch_interval;
+	/* Window in ms over which the features of the sensor are computed,
+	 * 0 to forward the samples */
+	uint16_t feature_window;
+};
+
+struct rawdata_collector_unsubscribe_req {
+	struct cfw_message header;
+	sensor_service_t handle;
+};
+
+struct rawdata_collector_throttle_req {
+	struct cfw_message header;
+	/* Only 1 sample out of 1 << shift is kept */
+	uint8_t shift;
+};
+
+struct rawdata_collector_rsp {
+	struct cfw_message header;
+	int status;
+};
+
+struct rawdata_collector_batch_evt {
+	struct cfw_message header;
+	/* Sensor reports packed since the previous batch */
+	uint8_t nb_reports;
+	uint8_t nb_records;
+	/* Size of the records array */
+	uint16_t length;
+	/* Consecutive records, each one is its datasize followed by the first
+	 * datasize bytes of a struct stored_data */
+	uint8_t records[];
+};
+
+/** Raw data collector service init.
+ * This opens the sensor service and registers the collector service.
+ *
+ * @param queue message queue of the service
+ * @param loop loop of the queue, on which the batches are flushed once their
+ *        interval elapsed
+ */
+void rawdata_collector_init(T_QUEUE queue, xloop_t *loop);
+
+/** Subscribe to a sensor through the collector.
+ * The records are sent in MSG_ID_RAWDATA_COLLECTOR_BATCH_EVT events.
+ *
+ * @param conn collector service connection
+ * @param priv private data returned in the response
+ * @param handle sensor handle
+ * @param frequency sampling rate frequency
+ * @param reporting_interval sensor reporting interval in ms
+ * @param batch_interval maximum time in ms covered by a batch
+ * @param feature_window window in ms over which the features of the sensor
+ *        are computed, 0 to forward the samples
+ * @return 0 on success
+ */
+int rawdata_collector_subscribe(cfw_service_conn_t *conn, void *priv,
+				sensor_service_t handle, uint16_t frequency,
+				uint16_t reporting_interval,
+				uint16_t batch_interval,
+				uint16_t feature_window);
+
+/** Unsubscribe from a sensor.
+ * The pending batch is sent before the response.
+ *
+ * @param conn collector service connection
+ * @param priv private data returned in the response
+ * @param handle sensor handle
+ * @return 0 on success
+ */
+int rawdata_collector_unsubscribe(cfw_service_conn_t *conn, void *priv,
+				  sensor_service_t handle);
+
+/** Divide the sampling rate of the subscribed sensors.
+ * The samples are decimated on the sensor core, their stream info reports
+ * the new rate. Features are computed on all the samples. The division is
+ * reset once no sensor is subscribed.
+ *
+ * @param conn collector service connection
+ * @param priv private data returned in the response
+ * @param shift only 1 sample out of 1 << shift is kept, up to
+ *        RAWDATA_COLLECTOR_MAX_THROTTLE
+ * @return 0 on success
+ */
+int rawdata_collector_throttle(cfw_service_conn_t *conn, void *priv,
+			       uint8_t shift);
+
+#endif
@@ -0,0 +1,112 @@
+/*
+ * Copyright (c) 2016, Intel Corporation. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ * this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ * this list of conditions and the following disclaimer in the documentation
+ * and/or other materials provided with the distribution.
+ *
+ * 3. Neither the name of the copyright holder nor the names of its contributors
+ * may be used to endorse or promote products derived from this software without
+ * specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef __RAWDATA_RECORD_H__
+#define __RAWDATA_RECORD_H__
+
+#include <stdint.h>
+
+#include "util/compiler.h"
+
+/* Size of a record in the raw data circular storage */
+#define RAWDATA_RECORD_SIZE          128
+
+/* Record payload: consecutive TLV, 1 byte for the sensor type, 1 byte for
+ * the length and the sensor data */
+#define RAWDATA_RECORD_TLV_HEADER    (2 * sizeof(uint8_t))
+
+/* Size of the accel and gyro samples in the sensor reports, the reports read
+ * from the hardware FIFO are split on these boundaries */
+#define RAWDATA_ACCEL_SAMPLE_SIZE    (3 * sizeof(int16_t))
+#define RAWDATA_GYRO_SAMPLE_SIZE     (3 * sizeof(int32_t))
+
+/* This structure represents the data stored in the circular storage */
+struct stored_data {
+	uint32_t timestamp;
+	/* Data collected between timestamp and timestamp + interval/2 */
+	uint8_t data[RAWDATA_RECORD_SIZE - sizeof(uint32_t) - sizeof(uint8_t)];
+	/* Actual size of the data = timestamp + valid portion of data array */
+	uint8_t datasize;
+};
+
+/* TLV type of the features computed over a window of a sensor samples.
+ * Sensor types are below 0x70, the types from 0xF0 are meta data */
+#define RAWDATA_FEATURES_TYPE(sensor_type)  (0x80 | (sensor_type))
+
+/* TLV type of the stream information of a sensor, see struct
+ * rawdata_stream_info */
+#define RAWDATA_STREAM_INFO_TYPE            0xF0
+
+/* TLV type of a time anchor, see struct rawdata_time_anchor */
+#define RAWDATA_TIME_ANCHOR_TYPE            0xF1
+
+/* Features of a sensor axis over a window, in the unit of the samples */
+struct rawdata_feature_axis {
+	int32_t mean;
+	/* Saturated to UINT32_MAX */
+	uint32_t variance;
+	/* Mean of the squared samples, saturated to UINT32_MAX */
+	uint32_t energy;
+	int32_t min;
+	int32_t max;
+	/* Crossings of the mean of the previous window */
+	uint16_t zero_crossings;
+} __packed;
+
+/* Payload of a RAWDATA_FEATURES_TYPE TLV, the record timestamp is the one of
+ * the last sample of the window */
+struct rawdata_features {
+	uint16_t nb_samples;
+	struct rawdata_feature_axis axis[3];
+} __packed;
+
+/* Rate of a sensor stream, stored when the stream starts and when its
+ * measured rate changes. It applies to the following records of the sensor */
+struct rawdata_stream_info {
+	uint8_t sensor_type;
+	/* Requested sampling rate frequency in Hz */
+	uint16_t frequency;
+	/* Sampling rate measured from the sample timestamps in mHz */
+	uint32_t rate;
+	/* Reporting interval in ms */
+	uint16_t reporting_interval;
+} __packed;
+
+/* Time anchor, stored when a session starts and periodically after. The
+ * record timestamps are the low 32 bits of the uptime: the anchor extends the
+ * ones within 24 days of it to 64 bits and maps them to the wall clock */
+struct rawdata_time_anchor {
+	/* Uptime in ms */
+	uint64_t uptime;
+	/* RTC time in s at that uptime */
+	uint32_t rtc_time;
+} __packed;
+
+#endif
@@ -1,6 +1,17 @@
 obj-y += main.o
 obj-y += ui_config.o
 obj-y += rawdata.o
+obj-y += rawdata_usb.o
+obj-y += rawdata_collector_api.o
+obj-y += rawdata_trace.o
+obj-$(CONFIG_TCMD) += rawdata_tcmd.o
+obj-$(CONFIG_TCMD) += pvp_tcmd.o
 obj-y += cir_storage_config.o
 obj-y += soc_config.o
 obj-y += pvp_events_generator.o
+obj-y += sensor_registry.o
+obj-y += binlog.o
+obj-y += msg_lanes.o
+obj-$(CONFIG_TCMD) += msg_lanes_tcmd.o
+obj-y += boot_timeline.o
+obj-$(CONFIG_TCMD) += boot_timeline_tcmd.o
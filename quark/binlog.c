@@ -0,0 +1,189 @@
+/*
+ * Copyright (c) 2016, Intel Corporation. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ * this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ * this list of conditions and the following disclaimer in the documentation
+ * and/or other materials provided with the distribution.
+ *
+ * 3. Neither the name of the copyright holder nor the names of its contributors
+ * may be used to endorse or promote products derived from this software without
+ * specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <stdarg.h>
+
+#include "os/os.h"
+#include "infra/time.h"
+
+#include "msg_lanes.h"
+#include "binlog.h"
+
+/* 1 kB ring, flushed BINLOG_FLUSH_PERIOD ms after it stops being empty. The
+ * lines are limited per flush so that the log buffer is not filled during a
+ * raw data session, and the flush waits BINLOG_BUSY_DELAY ms more while bulk
+ * messages are waiting in the main loop */
+#define BINLOG_RING_WORDS      256
+#define BINLOG_FLUSH_PERIOD    1000
+#define BINLOG_BUSY_DELAY      100
+#define BINLOG_LINE_WORDS      8
+#define BINLOG_LINES_PER_FLUSH 8
+
+/* An entry is a header word: ID << 16 | number of arguments, the uptime in ms
+ * and the arguments */
+#define BINLOG_HEADER(id, nargs) (((uint32_t)(id) << 16) | (nargs))
+#define BINLOG_HEADER_NARGS(header) ((header) & 0xFF)
+#define BINLOG_ENTRY_WORDS(nargs) (2 + (nargs))
+
+#ifdef BINLOG_TEXT
+const char *const binlog_formats[] = {
+#define BINLOG_MSG(name, module, level, format) format,
+#include "binlog_list.def"
+};
+#endif
+
+static struct binlog_ring {
+	uint32_t words[BINLOG_RING_WORDS];
+	uint16_t head;
+	uint16_t used;
+	/* Entries dropped since the last flush */
+	uint32_t dropped;
+	/* The flush timer is started, cleared once the ring is empty */
+	bool flush_armed;
+} ring;
+
+static xloop_t *flush_loop = NULL;
+static T_TIMER flush_timer = NULL;
+
+static void ring_put(uint32_t word)
+{
+	ring.words[(ring.head + ring.used) % BINLOG_RING_WORDS] = word;
+	ring.used++;
+}
+
+void binlog_write(uint16_t id, uint8_t nargs, ...)
+{
+	va_list ap;
+	uint32_t saved;
+	bool arm;
+
+	if (nargs > BINLOG_MAX_ARGS)
+		nargs = BINLOG_MAX_ARGS;
+	saved = interrupt_lock();
+	if (ring.used + BINLOG_ENTRY_WORDS(nargs) > BINLOG_RING_WORDS) {
+		ring.dropped++;
+		interrupt_unlock(saved);
+		return;
+	}
+	ring_put(BINLOG_HEADER(id, nargs));
+	ring_put(get_uptime_ms());
+	va_start(ap, nargs);
+	while (nargs--)
+		ring_put(va_arg(ap, uint32_t));
+	va_end(ap);
+	arm = !ring.flush_armed && flush_timer;
+	ring.flush_armed = true;
+	interrupt_unlock(saved);
+	if (arm)
+		timer_start(flush_timer, BINLOG_FLUSH_PERIOD, NULL);
+}
+
+/* Move whole entries of the ring to words, return the number of words */
+static int ring_get(uint32_t *words, int max)
+{
+	int count = 0;
+	uint32_t saved = interrupt_lock();
+
+	while (ring.used) {
+		int size = BINLOG_ENTRY_WORDS(BINLOG_HEADER_NARGS(
+						      ring.words[ring.head]));
+		if (count + size > max)
+			break;
+		while (size--) {
+			words[count++] = ring.words[ring.head];
+			ring.head = (ring.head + 1) % BINLOG_RING_WORDS;
+			ring.used--;
+		}
+	}
+	interrupt_unlock(saved);
+	return count;
+}
+
+static int flush_job(void *param)
+{
+	static const char digits[] = "0123456789abcdef";
+	uint32_t words[BINLOG_LINE_WORDS];
+	char line[BINLOG_LINE_WORDS * 9];
+	int lines = 0;
+	int count, i, shift;
+	uint32_t saved;
+	bool rearm;
+
+	/* The lines are only formatted once the main loop is idle */
+	if (msg_lanes_busy()) {
+		timer_start(flush_timer, BINLOG_BUSY_DELAY, NULL);
+		return 0;
+	}
+	if (ring.dropped) {
+		uint32_t dropped = ring.dropped;
+		ring.dropped = 0;
+		BINLOG(BINLOG_DROPPED, dropped);
+	}
+	while (lines++ < BINLOG_LINES_PER_FLUSH &&
+	       (count = ring_get(words, BINLOG_LINE_WORDS))) {
+		char *p = line;
+		for (i = 0; i < count; i++) {
+			for (shift = 28; shift >= 0; shift -= 4)
+				*p++ = digits[(words[i] >> shift) & 0xF];
+			*p++ = ' ';
+		}
+		p[-1] = '\0';
+		pr_info(LOG_MODULE_MAIN, "BL %s", line);
+	}
+	/* Go on with the remaining lines at the next period, or stay idle
+	 * until the next entry */
+	saved = interrupt_lock();
+	rearm = ring.used != 0;
+	ring.flush_armed = rearm;
+	interrupt_unlock(saved);
+	if (rearm)
+		timer_start(flush_timer, BINLOG_FLUSH_PERIOD, NULL);
+	return 0;
+}
+
+static void flush_timer_cb(void *param)
+{
+	xloop_post_func(flush_loop, flush_job, NULL);
+}
+
+void binlog_init(xloop_t *loop)
+{
+	uint32_t saved;
+
+	flush_loop = loop;
+	flush_timer = timer_create(flush_timer_cb, NULL, BINLOG_FLUSH_PERIOD,
+				   false, false, NULL);
+	/* Entries written before the timer exists */
+	saved = interrupt_lock();
+	ring.flush_armed = ring.used != 0;
+	interrupt_unlock(saved);
+	if (ring.flush_armed)
+		timer_start(flush_timer, BINLOG_FLUSH_PERIOD, NULL);
+}
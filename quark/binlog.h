@@ -0,0 +1,121 @@
+/*
+ * Copyright (c) 2016, Intel Corporation. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ * this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ * this list of conditions and the following disclaimer in the documentation
+ * and/or other materials provided with the distribution.
+ *
+ * 3. Neither the name of the copyright holder nor the names of its contributors
+ * may be used to endorse or promote products derived from this software without
+ * specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef __BINLOG_H__
+#define __BINLOG_H__
+
+#include <stdint.h>
+
+#include "infra/log.h"
+#include "infra/xloop.h"
+
+/* Binary log of the hot paths.
+ * A BINLOG() site only stores the message ID, the uptime and the raw integer
+ * arguments in a RAM ring. The ring is flushed from the idle main loop as hex
+ * lines of the log ("BL <words>"), formatted on the host by
+ * scripts/binlog_decode.py with the formats of binlog_list.def.
+ *
+ * Build with BINLOG_TEXT defined to format the sites with log_printk instead.
+ */
+
+#define BINLOG_LEVEL_ERROR    LOG_LEVEL_ERROR
+#define BINLOG_LEVEL_WARNING  LOG_LEVEL_WARNING
+#define BINLOG_LEVEL_INFO     LOG_LEVEL_INFO
+#define BINLOG_LEVEL_DEBUG    LOG_LEVEL_DEBUG
+
+/* Compile-time level of each module: the sites above it are removed. Override
+ * with -DBINLOG_LEVEL_<module>=BINLOG_LEVEL_DEBUG */
+#ifndef BINLOG_LEVEL_BINLOG
+#define BINLOG_LEVEL_BINLOG   BINLOG_LEVEL_WARNING
+#endif
+#ifndef BINLOG_LEVEL_RAWDATA
+#define BINLOG_LEVEL_RAWDATA  BINLOG_LEVEL_INFO
+#endif
+#ifndef BINLOG_LEVEL_PVP
+#define BINLOG_LEVEL_PVP      BINLOG_LEVEL_INFO
+#endif
+
+#define BINLOG_MAX_ARGS 4
+
+enum binlog_id {
+#define BINLOG_MSG(name, module, level, format) BINLOG_ID_ ## name,
+#include "binlog_list.def"
+	BINLOG_ID_COUNT
+};
+
+enum {
+#define BINLOG_MSG(name, module, level, format) \
+	BINLOG_ENABLED_ ## name = \
+		(BINLOG_LEVEL_ ## level <= BINLOG_LEVEL_ ## module),
+#include "binlog_list.def"
+};
+
+enum {
+#define BINLOG_MSG(name, module, level, format) \
+	BINLOG_SEVERITY_ ## name = BINLOG_LEVEL_ ## level,
+#include "binlog_list.def"
+};
+
+#define BINLOG_NARGS(...) BINLOG_NARGS_(0, ## __VA_ARGS__, 4, 3, 2, 1, 0)
+#define BINLOG_NARGS_(_0, _1, _2, _3, _4, n, ...) n
+
+#ifdef BINLOG_TEXT
+extern const char *const binlog_formats[];
+
+#define BINLOG(name, ...) \
+	do { \
+		if (BINLOG_ENABLED_ ## name) \
+			log_printk(BINLOG_SEVERITY_ ## name, LOG_MODULE_MAIN, \
+				   binlog_formats[BINLOG_ID_ ## name], \
+				   ## __VA_ARGS__); \
+	} while (0)
+#else
+#define BINLOG(name, ...) \
+	do { \
+		if (BINLOG_ENABLED_ ## name) \
+			binlog_write(BINLOG_ID_ ## name, \
+				     BINLOG_NARGS(__VA_ARGS__), ## __VA_ARGS__); \
+	} while (0)
+#endif
+
+/** Store a message in the ring.
+ * Use the BINLOG() macro: the message is dropped if the ring is full.
+ *
+ * @param id message ID
+ * @param nargs number of integer arguments that follow
+ */
+void binlog_write(uint16_t id, uint8_t nargs, ...);
+
+/** Binary log init.
+ * This starts the periodic flush of the ring on the main loop.
+ */
+void binlog_init(xloop_t *loop);
+
+#endif
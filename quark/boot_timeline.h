@@ -0,0 +1,75 @@
+/*
+ * Copyright (c) 2016, Intel Corporation. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ * this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ * this list of conditions and the following disclaimer in the documentation
+ * and/or other materials provided with the distribution.
+ *
+ * 3. Neither the name of the copyright holder nor the names of its contributors
+ * may be used to endorse or promote products derived from this software without
+ * specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef __BOOT_TIMELINE_H__
+#define __BOOT_TIMELINE_H__
+
+#include <stdbool.h>
+#include <stdint.h>
+
+/* Boot steps, in their usual order. Each one is dated the first time it is
+ * reached, from the reset */
+enum boot_step {
+	/* Entry of the main task */
+	BOOT_STEP_MAIN,
+	/* BSP of both cores initialized */
+	BOOT_STEP_BSP,
+	BOOT_STEP_CFW,
+	/* Services started, entry of the main loop */
+	BOOT_STEP_MAIN_LOOP,
+	/* BLE application ready */
+	BOOT_STEP_BLE,
+	/* First sensor found by the scan */
+	BOOT_STEP_SENSORS,
+	/* Raw data storage and collector available */
+	BOOT_STEP_RAWDATA_STORAGE,
+	BOOT_STEP_RAWDATA_COLLECTOR,
+	/* PVP events generator started */
+	BOOT_STEP_PVP,
+	/* First sensor record received from the collector */
+	BOOT_STEP_FIRST_SAMPLE,
+	BOOT_STEPS
+};
+
+/** Date a boot step, if not reached yet.
+ *
+ * @param step boot step
+ */
+void boot_timeline_mark(enum boot_step step);
+
+/** Get the date of a boot step.
+ *
+ * @param step boot step
+ * @param time filled with the time from the reset in 32 kHz ticks
+ * @return false if the step is not reached yet
+ */
+bool boot_timeline_get(enum boot_step step, uint32_t *time);
+
+#endif
@@ -0,0 +1,110 @@
+/*
+ * Copyright (c) 2016, Intel Corporation. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ * this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ * this list of conditions and the following disclaimer in the documentation
+ * and/or other materials provided with the distribution.
+ *
+ * 3. Neither the name of the copyright holder nor the names of its contributors
+ * may be used to endorse or promote products derived from this software without
+ * specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <stdio.h>
+
+#include "infra/tcmd/handler.h"
+
+#include "boot_timeline.h"
+
+static const char *const step_names[BOOT_STEPS] = {
+	[BOOT_STEP_MAIN] = "main",
+	[BOOT_STEP_BSP] = "bsp",
+	[BOOT_STEP_CFW] = "cfw",
+	[BOOT_STEP_MAIN_LOOP] = "main loop",
+	[BOOT_STEP_BLE] = "ble",
+	[BOOT_STEP_SENSORS] = "sensors",
+	[BOOT_STEP_RAWDATA_STORAGE] = "rawdata storage",
+	[BOOT_STEP_RAWDATA_COLLECTOR] = "rawdata collector",
+	[BOOT_STEP_PVP] = "pvp",
+	[BOOT_STEP_FIRST_SAMPLE] = "first sample",
+};
+
+/* 32 kHz ticks to us */
+#define TICKS_TO_US(ticks) ((uint32_t)(((uint64_t)(ticks) * 1000000) / 32768))
+
+/*
+ * Print the boot timeline: boot timeline
+ * The steps reached are printed in chronological order with their time from
+ * the reset and from the previous step in ms, then the steps not reached yet.
+ *
+ * @param[in]   argc        Number of arguments in the Test Command (including group and name)
+ * @param[in]   argv        Table of null-terminated buffers containing the arguments
+ * @param[in]   ctx         The context to pass back to responses
+ */
+void boot_tcmd_timeline(int argc, char *argv[], struct tcmd_handler_ctx *ctx)
+{
+	uint8_t order[BOOT_STEPS];
+	uint32_t times[BOOT_STEPS];
+	uint8_t nb_reached = 0;
+	uint8_t nb_steps;
+	uint32_t time;
+	uint32_t previous = 0;
+	char buf[64];
+	uint8_t i, j;
+
+	/* Reached steps sorted by time first, then the missing ones */
+	for (i = 0; i < BOOT_STEPS; i++) {
+		if (!boot_timeline_get(i, &time))
+			continue;
+		for (j = nb_reached; j && times[j - 1] > time; j--) {
+			order[j] = order[j - 1];
+			times[j] = times[j - 1];
+		}
+		order[j] = i;
+		times[j] = time;
+		nb_reached++;
+	}
+	nb_steps = nb_reached;
+	for (i = 0; i < BOOT_STEPS; i++)
+		if (!boot_timeline_get(i, &time))
+			order[nb_steps++] = i;
+
+	for (i = 0; i < BOOT_STEPS; i++) {
+		if (i < nb_reached) {
+			uint32_t us = TICKS_TO_US(times[i]);
+			uint32_t delta = us - previous;
+			snprintf(buf, sizeof(buf), "%s: %u.%03u ms (+%u.%03u)",
+				 step_names[order[i]], (unsigned int)(us / 1000),
+				 (unsigned int)(us % 1000),
+				 (unsigned int)(delta / 1000),
+				 (unsigned int)(delta % 1000));
+			previous = us;
+		} else {
+			snprintf(buf, sizeof(buf), "%s: -",
+				 step_names[order[i]]);
+		}
+		if (i < BOOT_STEPS - 1)
+			TCMD_RSP_PROVISIONAL(ctx, buf);
+	}
+	TCMD_RSP_FINAL(ctx, buf);
+}
+
+DECLARE_TEST_COMMAND(boot, timeline, boot_tcmd_timeline);
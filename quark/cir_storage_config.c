@@ -33,6 +33,7 @@
 #include "cfw/cfw.h"
 #include "services/circular_storage_service/circular_storage_service.h"
 #include "rawdata.h"
+#include "pvp_events_generator.h"
 #include "iq/init_iq.h"
 
 enum {
@@ -57,8 +58,9 @@ struct circular_storage_configuration cir_storage_config = {
 			.key = PVP_STORAGE_KEY,
 			.partition_id = SPI_PVP_EVENTS_PARTITION_ID,
 			.first_block = SPI_PVP_EVENTS_START_BLOCK,
-			.block_count = SPI_PVP_EVENTS_END_BLOCK,
-			.element_size = PVP_STORAGE_ELT_SIZE,
+			.block_count = SPI_PVP_EVENTS_NB_BLOCKS,
+			/* The classifier results are stored in batches */
+			.element_size = PVP_RECORD_ELT_SIZE,
 		},
 	},
 	.cir_storage_count = CIR_STORAGE_CONFIG_COUNT,
@@ -58,6 +58,16 @@
 
 /* PVP events */
 #include "pvp_events_generator.h"
+#include "sensor_registry.h"
+
+/* Binary log of the hot paths */
+#include "binlog.h"
+
+/* Priority lanes of the main loop */
+#include "msg_lanes.h"
+
+/* Boot instrumentation */
+#include "boot_timeline.h"
 
 /* System main queue it will be used on the component framework to add messages
  * on it. */
@@ -93,12 +103,14 @@ int wdt_func(void *param)
 
 void ble_app_ready(void)
 {
+	boot_timeline_mark(BOOT_STEP_BLE);
 	ble_ispp_init();
 }
 
 static void pvp_event_generator_initialized(void)
 {
 	pvp_events_generator_start();
+	boot_timeline_mark(BOOT_STEP_PVP);
 }
 
 /* Application main entry point */
@@ -106,9 +118,12 @@ void main_task(void *param)
 {
 	bool factory_mode = *(bool *)param;
 
+	boot_timeline_mark(BOOT_STEP_MAIN);
+
 	/* Init BSP (also init BSP on ARC core) */
 	queue = bsp_init();
 
+	boot_timeline_mark(BOOT_STEP_BSP);
 	pr_info(LOG_MODULE_MAIN, "BSP init done");
 
 	/* start Quark watchdog */
@@ -119,8 +134,21 @@ void main_task(void *param)
 
 	/* Init the CFW */
 	cfw_init(queue);
+	boot_timeline_mark(BOOT_STEP_CFW);
 	pr_info(LOG_MODULE_MAIN, "CFW init done");
 
+	xloop_init_from_queue(&loop, queue);
+
+	/* Flush of the binary log entries to the log */
+	binlog_init(&loop);
+
+	/* Bulk messages handled after the transport completions */
+	msg_lanes_init(&loop);
+
+	/* Sensor scanning and handles shared by raw data and PVP. The scan
+	 * runs on the sensor core while the other services start */
+	sensor_registry_init(queue);
+
 	/* Init IQs before services to make sure that the user events IQ module
 	 * is the first to subscribe to button press events when services are available. */
 	if (!factory_mode)
@@ -136,15 +164,14 @@ void main_task(void *param)
 	pr_info(LOG_MODULE_MAIN, "%s service init in progress...", "UI");
 
 	/* Raw Data sensor collection initialization */
-	rawdata_init(queue);
+	rawdata_init(queue, &loop);
 
 	/* PVP events initialization */
-	pvp_events_generator_init(queue, pvp_event_generator_initialized);
-
-	xloop_init_from_queue(&loop, queue);
+	pvp_events_generator_init(queue, &loop, pvp_event_generator_initialized);
 
 	pr_info(LOG_MODULE_MAIN, "Quark go to main loop");
 
 	xloop_post_func_periodic(&loop, wdt_func, NULL, WDT_MAX_TIMEOUT_MS / 2);
+	boot_timeline_mark(BOOT_STEP_MAIN_LOOP);
 	xloop_run(&loop);
 }
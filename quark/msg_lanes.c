@@ -0,0 +1,155 @@
+/*
+ * Copyright (c) 2016, Intel Corporation. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ * this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ * this list of conditions and the following disclaimer in the documentation
+ * and/or other materials provided with the distribution.
+ *
+ * 3. Neither the name of the copyright holder nor the names of its contributors
+ * may be used to endorse or promote products derived from this software without
+ * specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <stdbool.h>
+#include <string.h>
+
+#include "util/misc.h"
+#include "os/os.h"
+#include "infra/time.h"
+
+#include "msg_lanes.h"
+
+/* Messages held by the bulk lane: they are kept allocated until handled */
+#define MSG_LANE_BULK_DEPTH 8
+
+#define TICKS_TO_US(ticks) ((uint32_t)(((uint64_t)(ticks) * 1000000) / 32768))
+
+struct lane_entry {
+	struct cfw_message *msg;
+	msg_lane_handler_t handler;
+	/* 32 kHz uptime of the post */
+	uint32_t post_time;
+};
+
+static struct bulk_lane {
+	struct lane_entry entries[MSG_LANE_BULK_DEPTH];
+	uint8_t head;
+	uint8_t count;
+	/* Set when a job is waiting in the main loop */
+	bool job_posted;
+} bulk;
+
+static struct lane_counters {
+	struct msg_lane_stats stats;
+	uint64_t wait_total;
+} counters[MSG_LANES];
+
+static xloop_t *lanes_loop = NULL;
+
+static void handle_entry(enum msg_lane lane, const struct lane_entry *entry)
+{
+	struct lane_counters *c = &counters[lane];
+	uint32_t wait = TICKS_TO_US((uint32_t)get_uptime_32k() -
+				    entry->post_time);
+
+	c->stats.messages++;
+	c->stats.wait_max = MAX(c->stats.wait_max, wait);
+	c->wait_total += wait;
+	entry->handler(entry->msg);
+}
+
+/* Remove the oldest bulk message from the lane and handle it */
+static void handle_oldest(void)
+{
+	struct lane_entry entry = bulk.entries[bulk.head];
+
+	bulk.head = (bulk.head + 1) % MSG_LANE_BULK_DEPTH;
+	bulk.count--;
+	handle_entry(MSG_LANE_BULK, &entry);
+}
+
+/* Handle the oldest bulk message, the next one is left to the next job so
+ * that the messages received meanwhile are handled first */
+static int bulk_job(void *param)
+{
+	bulk.job_posted = false;
+	if (!bulk.count)
+		return 0;
+	if (bulk.count > 1) {
+		bulk.job_posted = true;
+		xloop_post_func(lanes_loop, bulk_job, NULL);
+	}
+	handle_oldest();
+	return 0;
+}
+
+void msg_lanes_post(enum msg_lane lane, struct cfw_message *msg,
+		    msg_lane_handler_t handler)
+{
+	struct lane_entry entry = {
+		.msg = msg,
+		.handler = handler,
+		.post_time = get_uptime_32k(),
+	};
+	struct msg_lane_stats *stats = &counters[lane].stats;
+
+	if (lane == MSG_LANE_PRIORITY || !lanes_loop) {
+		stats->overtaken += bulk.count;
+		handle_entry(lane, &entry);
+		return;
+	}
+	if (bulk.count == MSG_LANE_BULK_DEPTH) {
+		/* Keep the order: the oldest message is handled to make room,
+		 * the job already posted goes on with the next ones */
+		stats->overflows++;
+		handle_oldest();
+	}
+	bulk.entries[(bulk.head + bulk.count) % MSG_LANE_BULK_DEPTH] = entry;
+	bulk.count++;
+	stats->depth_max = MAX(stats->depth_max, bulk.count);
+	if (!bulk.job_posted) {
+		bulk.job_posted = true;
+		xloop_post_func(lanes_loop, bulk_job, NULL);
+	}
+}
+
+void msg_lanes_get_stats(enum msg_lane lane, struct msg_lane_stats *stats)
+{
+	*stats = counters[lane].stats;
+	stats->depth = lane == MSG_LANE_BULK ? bulk.count : 0;
+	if (stats->messages)
+		stats->wait_avg = counters[lane].wait_total / stats->messages;
+}
+
+bool msg_lanes_busy(void)
+{
+	return bulk.count != 0;
+}
+
+void msg_lanes_reset_stats(void)
+{
+	memset(counters, 0, sizeof(counters));
+}
+
+void msg_lanes_init(xloop_t *loop)
+{
+	lanes_loop = loop;
+}
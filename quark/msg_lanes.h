@@ -0,0 +1,101 @@
+/*
+ * Copyright (c) 2016, Intel Corporation. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ * this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ * this list of conditions and the following disclaimer in the documentation
+ * and/or other materials provided with the distribution.
+ *
+ * 3. Neither the name of the copyright holder nor the names of its contributors
+ * may be used to endorse or promote products derived from this software without
+ * specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef __MSG_LANES_H__
+#define __MSG_LANES_H__
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "cfw/cfw.h"
+#include "infra/xloop.h"
+
+/* Priority lanes of the main loop.
+ * The CFW messages are received in FIFO order. The clients post the bulk
+ * messages (sensor data) to the bulk lane, handled one per main loop round,
+ * and the completions that keep the transport busy (storage responses) to the
+ * priority lane, handled at once: they overtake the bulk messages received
+ * before them. A client posts the messages whose order matters to the same
+ * lane. */
+enum msg_lane {
+	MSG_LANE_PRIORITY,
+	MSG_LANE_BULK,
+	MSG_LANES
+};
+
+/* Handler of a posted message, it frees the message */
+typedef void (*msg_lane_handler_t)(struct cfw_message *msg);
+
+struct msg_lane_stats {
+	/* Messages handled */
+	uint32_t messages;
+	/* Bulk messages overtaken by the messages of the lane */
+	uint32_t overtaken;
+	/* Messages handled at once because the lane was full */
+	uint32_t overflows;
+	/* Messages waiting in the lane, now and at most */
+	uint16_t depth;
+	uint16_t depth_max;
+	/* Time between the post and the handling of the messages, in us */
+	uint32_t wait_max;
+	uint32_t wait_avg;
+};
+
+/** Post a message to a lane.
+ *
+ * @param lane lane of the message
+ * @param msg message, freed by the handler
+ * @param handler message handler
+ */
+void msg_lanes_post(enum msg_lane lane, struct cfw_message *msg,
+		    msg_lane_handler_t handler);
+
+/** Get the statistics of a lane.
+ *
+ * @param lane lane
+ * @param stats statistics
+ */
+void msg_lanes_get_stats(enum msg_lane lane, struct msg_lane_stats *stats);
+
+/** Check whether bulk messages are waiting in the main loop.
+ *
+ * @return true if the bulk lane holds messages
+ */
+bool msg_lanes_busy(void);
+
+/** Reset the statistics of all the lanes */
+void msg_lanes_reset_stats(void);
+
+/** Lanes init.
+ * The bulk lane is handled by jobs of the main loop.
+ */
+void msg_lanes_init(xloop_t *loop);
+
+#endif
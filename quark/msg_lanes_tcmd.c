@@ -0,0 +1,82 @@
+/*
+ * Copyright (c) 2016, Intel Corporation. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ * this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ * this list of conditions and the following disclaimer in the documentation
+ * and/or other materials provided with the distribution.
+ *
+ * 3. Neither the name of the copyright holder nor the names of its contributors
+ * may be used to endorse or promote products derived from this software without
+ * specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <stdio.h>
+#include <string.h>
+
+#include "infra/tcmd/handler.h"
+
+#include "msg_lanes.h"
+
+static const char *const lane_names[MSG_LANES] = {
+	[MSG_LANE_PRIORITY] = "priority",
+	[MSG_LANE_BULK] = "bulk",
+};
+
+/*
+ * Print the statistics of the main loop lanes: lanes stats [reset]
+ * Each lane prints the messages handled, the bulk messages they overtook, the
+ * overflows, the current and maximum depth and the maximum and average wait
+ * in us. reset clears the statistics after printing them.
+ *
+ * @param[in]   argc        Number of arguments in the Test Command (including group and name)
+ * @param[in]   argv        Table of null-terminated buffers containing the arguments
+ * @param[in]   ctx         The context to pass back to responses
+ */
+void lanes_tcmd_stats(int argc, char *argv[], struct tcmd_handler_ctx *ctx)
+{
+	struct msg_lane_stats stats;
+	char buf[80];
+	uint8_t i;
+
+	if (argc > 3 || (argc == 3 && strcmp(argv[2], "reset"))) {
+		TCMD_RSP_ERROR(ctx, "Usage: lanes stats [reset]");
+		return;
+	}
+
+	for (i = 0; i < MSG_LANES; i++) {
+		msg_lanes_get_stats(i, &stats);
+		snprintf(buf, sizeof(buf),
+			 "%s: msg %u overtaken %u overflow %u depth %d/%d "
+			 "wait %u/%u",
+			 lane_names[i], (unsigned int)stats.messages,
+			 (unsigned int)stats.overtaken,
+			 (unsigned int)stats.overflows, stats.depth,
+			 stats.depth_max, (unsigned int)stats.wait_max,
+			 (unsigned int)stats.wait_avg);
+		if (i < MSG_LANES - 1)
+			TCMD_RSP_PROVISIONAL(ctx, buf);
+	}
+	if (argc == 3)
+		msg_lanes_reset_stats();
+	TCMD_RSP_FINAL(ctx, buf);
+}
+
+DECLARE_TEST_COMMAND(lanes, stats, lanes_tcmd_stats);
@@ -32,68 +32,264 @@
 
 #include "os/os.h"
 #include "infra/log.h"
+#include "infra/time.h"
 
 #include "cfw/cfw.h"
+#include "services/circular_storage_service/circular_storage_service.h"
 #include "lib/ble/pattern/ble_pattern.h"
 
-/* Main sensors API */
-#include "services/sensor_service/sensor_service.h"
-
+#include "sensor_registry.h"
+#include "binlog.h"
 #include "pvp_events_generator.h"
 #include "iq/pvp_events_iq.h"
 
+/* Classifier results are kept in RAM and stored as one record per batch,
+ * when the batch is full or every PVP_FLUSH_PERIOD ms. The flush only runs
+ * while the KB is subscribed or results are pending */
+#define PVP_FLUSH_PERIOD  1000
+
+static struct classifier_batch {
+	uint16_t labels[PVP_BATCH_SIZE];
+	uint8_t count;
+	/* RTC time of the first result */
+	uint32_t start;
+	/* Results stored since the last log */
+	uint16_t nb_pushed;
+} batch;
+
+static xloop_t *main_loop = NULL;
+static T_TIMER flush_timer = NULL;
+static bool flush_armed = false;
+
+static void (*init_done_callback)(void) = NULL;
+
 /* Client */
 static cfw_client_t *client = NULL;
 
-/* Sensors client */
-static cfw_service_conn_t *sensor_service_conn = NULL;
+static cfw_service_conn_t *circular_storage_service_conn = NULL;
 
-static sensor_service_t pvp_handle = NULL;
+/* In histogram mode the results are counted over buckets, each bucket is
+ * stored once over */
+static struct histogram_state {
+	enum pvp_storage_mode mode;
+	uint16_t bucket_duration;
+	/* PVP events storage, of the results and histogram records */
+	cir_storage_t *storage;
+	bool open;
+	/* Uptime of the bucket start */
+	uint32_t start_time;
+	struct pvp_histogram bucket;
+} histogram = {
+	.mode = PVP_STORAGE_EVENTS,
+	.bucket_duration = PVP_DEFAULT_BUCKET_DURATION,
+};
 
-static void (*init_done_callback)(void) = NULL;
+/* The KB is subscribed at the active rate, and at the idle rate once no
+ * class is detected for the idle timeout */
+static struct kb_rate_state {
+	struct pvp_rate_config config;
+	bool running;
+	bool idle;
+	uint32_t last_detection;
+} kb = {
+	.config = {
+		.active = { PVP_DEFAULT_FREQUENCY, PVP_DEFAULT_INTERVAL },
+	},
+};
 
-struct track_pattern_events{
- uint8_t total_pattern_square;
-}track_pattern_events_debug = {0};
+/* KB class notified as PATTERN_SQUARE */
+#define PVP_SQUARE_CLASS  2
 
-/* handle for sensors data */
-static void handle_sensor_subscribe_data(struct cfw_message *msg)
+/* Detections are counted per KB class and the BLE pattern notifications are
+ * sent at most once per interval, with the counters of the classes detected
+ * since the previous notification */
+static struct pattern_notify_state {
+	uint32_t counts[PVP_NB_CLASSES];
+	/* Classes detected since the last notification */
+	uint32_t pending_mask;
+	uint16_t interval;
+	uint32_t last_time;
+} notify = {
+	.interval = PVP_DEFAULT_NOTIFY_INTERVAL,
+};
+
+/* The classes without a named BLE pattern are notified with their KB class
+ * as pattern type */
+static uint8_t pattern_of_class(uint8_t label)
+{
+	return label == PVP_SQUARE_CLASS ? PATTERN_SQUARE : label;
+}
+
+static void notify_patterns(void)
+{
+	uint32_t now = get_uptime_ms();
+
+	if (!notify.pending_mask || now - notify.last_time < notify.interval)
+		return;
+
+	/* Class 0 is no detection and is never pending */
+	for (uint8_t label = 1; label < PVP_NB_CLASSES; label++) {
+		if (!(notify.pending_mask & (1 << label)))
+			continue;
+		/* The BLE pattern counter is on 8 bits, saturate it */
+		ble_pattern_update(MIN(notify.counts[label], UINT8_MAX),
+				   pattern_of_class(label));
+	}
+	notify.pending_mask = 0;
+	notify.last_time = now;
+}
+
+static void subscribe_kb(bool idle)
+{
+	const struct pvp_rate *rate = idle ? &kb.config.idle :
+					     &kb.config.active;
+
+	kb.idle = idle;
+	sensor_registry_subscribe(SENSOR_REGISTRY_PVP, SENSOR_ALGO_KB,
+				  ACCEL_DATA, rate->frequency, rate->interval);
+	pr_debug(LOG_MODULE_MAIN, "KB %s: %d Hz, %d ms",
+		 idle ? "idle" : "active", rate->frequency, rate->interval);
+}
+
+/* Push a record to the PVP events storage, it is freed on the response */
+static void push_record(struct pvp_record *record)
+{
+	if (!histogram.storage) {
+		pr_warning(LOG_MODULE_MAIN, "No PVP events storage");
+		bfree(record);
+		return;
+	}
+	circular_storage_service_push(circular_storage_service_conn,
+				      (uint8_t *)record, histogram.storage,
+				      record);
+}
+
+static void close_bucket(void)
+{
+	struct pvp_record *record;
+
+	if (!histogram.open)
+		return;
+	histogram.open = false;
+	histogram.bucket.duration =
+		(get_uptime_ms() - histogram.start_time + 500) / 1000;
+
+	record = balloc(sizeof(*record), NULL);
+	memset(record, 0, sizeof(*record));
+	record->type = PVP_RECORD_HISTOGRAM;
+	record->histogram = histogram.bucket;
+	push_record(record);
+}
+
+static void store_results(void)
 {
-	sensor_service_subscribe_data_event_t *p_evt =
-		(sensor_service_subscribe_data_event_t *)msg;
-	uint8_t sensor_type = GET_SENSOR_TYPE(p_evt->handle);
-	sensor_service_sensor_data_header_t *p_data_header =
-		&p_evt->sensor_data_header;
+	struct pvp_record *record = balloc(sizeof(*record), NULL);
+	uint8_t i;
+
+	memset(record, 0, sizeof(*record));
+	record->type = PVP_RECORD_RESULTS;
+	record->results.start = batch.start;
+	record->results.count = batch.count;
+	for (i = 0; i < batch.count; i++)
+		record->results.labels[i] = MIN(batch.labels[i], UINT8_MAX);
+	push_record(record);
+}
 
+static void count_result(uint16_t label)
+{
+	if (!histogram.open) {
+		memset(&histogram.bucket, 0, sizeof(histogram.bucket));
+		histogram.bucket.start = time();
+		histogram.start_time = get_uptime_ms();
+		histogram.open = true;
+	}
+	if (label < PVP_NB_CLASSES && histogram.bucket.counts[label] < UINT16_MAX)
+		histogram.bucket.counts[label]++;
+}
+
+static void flush_classifiers(void)
+{
+	uint8_t i;
+
+	if (!batch.count)
+		return;
+	if (histogram.mode == PVP_STORAGE_HISTOGRAM)
+		for (i = 0; i < batch.count; i++)
+			count_result(batch.labels[i]);
+	else
+		store_results();
+	batch.nb_pushed += batch.count;
+	batch.count = 0;
+}
+
+static void arm_flush(void)
+{
+	if (flush_armed || !flush_timer)
+		return;
+	flush_armed = true;
+	timer_start(flush_timer, PVP_FLUSH_PERIOD, NULL);
+}
+
+static int flush_job(void *param)
+{
+	flush_armed = false;
+	flush_classifiers();
+	if (histogram.open && get_uptime_ms() - histogram.start_time >=
+	    histogram.bucket_duration * 1000)
+		close_bucket();
+	if (batch.nb_pushed) {
+		BINLOG(PVP_CLASSIFIER_SUMMARY, batch.nb_pushed,
+		       notify.counts[PVP_SQUARE_CLASS]);
+		batch.nb_pushed = 0;
+	}
+	/* Last detections of a burst */
+	notify_patterns();
+	if (kb.running && !kb.idle && kb.config.idle_timeout &&
+	    get_uptime_ms() - kb.last_detection >= kb.config.idle_timeout)
+		subscribe_kb(true);
+	/* Nothing left to flush once the KB is stopped */
+	if (kb.running || batch.count || histogram.open ||
+	    notify.pending_mask)
+		arm_flush();
+	return 0;
+}
+
+static void flush_timer_cb(void *param)
+{
+	xloop_post_func(main_loop, flush_job, NULL);
+}
+
+/* handle for sensors data */
+static void handle_sensor_data(uint8_t sensor_type,
+			       sensor_service_sensor_data_header_t *p_data_header)
+{
 	switch (sensor_type) {
 	case SENSOR_ALGO_KB:;
-		/* Push data */
+		/* Keep the result for the next batch */
 		struct kb_result *p =
 			(struct kb_result *)p_data_header->data;
-		pr_info(LOG_MODULE_MAIN, "KB classifier=%d", p->nClassLabel);
-		pvp_event_push_classifier(p->nClassLabel);
-		if (p->nClassLabel==2)
-		{
-			track_pattern_events_debug.total_pattern_square++;
-			ble_pattern_update(track_pattern_events_debug.total_pattern_square,PATTERN_SQUARE);
+		if (!batch.count)
+			batch.start = time();
+		batch.labels[batch.count++] = p->nClassLabel;
+		if (batch.count == PVP_BATCH_SIZE)
+			flush_classifiers();
+		if (p->nClassLabel > 0 && p->nClassLabel < PVP_NB_CLASSES) {
+			notify.counts[p->nClassLabel]++;
+			notify.pending_mask |= 1 << p->nClassLabel;
+			kb.last_detection = get_uptime_ms();
+			if (kb.idle)
+				subscribe_kb(false);
 		}
+		notify_patterns();
+		arm_flush();
 		break;
 	}
 }
 
-static void handle_start_scanning_evt(struct cfw_message *msg)
+static void handle_sensor_found(uint8_t sensor_type, sensor_service_t handle)
 {
-	sensor_service_scan_event_t *p_evt = (sensor_service_scan_event_t *)msg;
-	sensor_service_on_board_scan_data_t on_board_data =
-		p_evt->on_board_data;
-	uint8_t sensor_type = p_evt->sensor_type;
-
 	switch (sensor_type) {
 	case SENSOR_ALGO_KB:
-		pvp_handle = GET_SENSOR_HANDLE(sensor_type,
-					       on_board_data.
-					       ch_id);
-
 		pvp_events_iq_set_start_cb(pvp_events_generator_start);
 		pvp_events_iq_set_end_cb(pvp_events_generator_end);
 		if (init_done_callback) {
@@ -103,14 +299,87 @@ static void handle_start_scanning_evt(struct cfw_message *msg)
 	}
 }
 
+static const struct sensor_registry_consumer pvp_consumer = {
+	.sensor_mask = ALGO_KB_MASK,
+	.scan_cb = handle_sensor_found,
+	.data_cb = handle_sensor_data,
+};
+
+void pvp_events_generator_start(void)
+{
+	kb.running = true;
+	kb.last_detection = get_uptime_ms();
+	subscribe_kb(false);
+	arm_flush();
+}
+
+void pvp_events_generator_end(void)
+{
+	kb.running = false;
+	sensor_registry_unsubscribe(SENSOR_REGISTRY_PVP, SENSOR_ALGO_KB);
+	flush_classifiers();
+	close_bucket();
+}
+
+bool pvp_events_generator_set_storage(enum pvp_storage_mode mode,
+				      uint16_t bucket_duration)
+{
+	if (mode == PVP_STORAGE_HISTOGRAM && !bucket_duration)
+		return false;
+
+	flush_classifiers();
+	close_bucket();
+	histogram.mode = mode;
+	if (bucket_duration)
+		histogram.bucket_duration = bucket_duration;
+	return true;
+}
+
+bool pvp_events_generator_set_rate(const struct pvp_rate_config *config)
+{
+	if (!config->active.frequency ||
+	    (config->idle_timeout && !config->idle.frequency))
+		return false;
+
+	kb.config = *config;
+	if (kb.running)
+		subscribe_kb(kb.idle && kb.config.idle_timeout);
+	return true;
+}
+
+const struct pvp_rate_config *pvp_events_generator_get_rate(void)
+{
+	return &kb.config;
+}
+
+void pvp_events_generator_set_notify_interval(uint16_t interval)
+{
+	notify.interval = interval;
+}
+
+uint32_t pvp_events_generator_get_count(uint8_t class_label)
+{
+	return class_label < PVP_NB_CLASSES ? notify.counts[class_label] : 0;
+}
+
 static void handle_msg(struct cfw_message *msg, void *data)
 {
 	switch (CFW_MESSAGE_ID(msg)) {
-	case MSG_ID_SENSOR_SERVICE_START_SCANNING_EVT:
-		handle_start_scanning_evt(msg);
+	case MSG_ID_CIRCULAR_STORAGE_SERVICE_GET_RSP:;
+		circular_storage_service_get_rsp_msg_t *init_resp =
+			(circular_storage_service_get_rsp_msg_t *)msg;
+		if (init_resp->status == DRV_RC_OK)
+			histogram.storage = init_resp->storage;
+		else
+			pr_error(LOG_MODULE_MAIN,
+				 "Circular storage get failure [%d]",
+				 init_resp->status);
 		break;
-	case MSG_ID_SENSOR_SERVICE_SUBSCRIBE_DATA_EVT:
-		handle_sensor_subscribe_data(msg);
+	case MSG_ID_CIRCULAR_STORAGE_SERVICE_PUSH_RSP:
+		bfree(CFW_MESSAGE_PRIV(msg));
+		if (((circular_storage_service_push_rsp_msg_t *)msg)->status !=
+		    DRV_RC_OK)
+			BINLOG(PVP_WRITE_FAILURE);
 		break;
 	default: break;
 	}
@@ -119,37 +388,27 @@ static void handle_msg(struct cfw_message *msg, void *data)
 
 static void service_connection_cb(cfw_service_conn_t *handle, void *param)
 {
-	sensor_service_conn = handle;
-	sensor_service_start_scanning(handle, NULL, ALGO_KB_MASK);
+	circular_storage_service_conn = handle;
+	circular_storage_service_get(circular_storage_service_conn,
+				     PVP_STORAGE_KEY, NULL);
 }
 
-void pvp_events_generator_start(void)
+void pvp_events_generator_init(T_QUEUE queue, xloop_t *loop,
+			       void (*init_done_cb)(void))
 {
-	uint8_t data_type = ACCEL_DATA;
-
-	if (pvp_handle)
-		sensor_service_subscribe_data(sensor_service_conn, NULL,
-					      pvp_handle,
-					      &data_type, 1, 100,
-					      10);
-}
-
-void pvp_events_generator_end(void)
-{
-	uint8_t data_type = ACCEL_DATA;
+	client = cfw_client_init(queue, handle_msg, NULL);
 
-	if (pvp_handle)
-		sensor_service_unsubscribe_data(sensor_service_conn, NULL,
-						pvp_handle, &data_type, 1);
-}
+	/* Open the circular_storage service for the classifier records */
+	cfw_open_service_helper(client, CIRCULAR_STORAGE_SERVICE_ID,
+				service_connection_cb,
+				(void *)CIRCULAR_STORAGE_SERVICE_ID);
 
-void pvp_events_generator_init(T_QUEUE queue, void (*init_done_cb)(void))
-{
-	client = cfw_client_init(queue, handle_msg, NULL);
+	main_loop = loop;
+	flush_timer = timer_create(flush_timer_cb, NULL, PVP_FLUSH_PERIOD,
+				   false, false, NULL);
 
 	init_done_callback = init_done_cb;
 
-	/* Open the sensor service */
-	cfw_open_service_helper(client, ARC_SC_SVC_ID,
-				service_connection_cb, (void *)ARC_SC_SVC_ID);
+	/* The KB is found by the scan of the sensor registry */
+	sensor_registry_register(SENSOR_REGISTRY_PVP, &pvp_consumer);
 }
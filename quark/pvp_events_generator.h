@@ -32,12 +32,99 @@
 #ifndef __PVP_EVENTS_GENERATOR_H__
 #define __PVP_EVENTS_GENERATOR_H__
 
+#include <stdbool.h>
+#include <stdint.h>
+
 #include "os/os.h"
+#include "util/compiler.h"
+#include "infra/xloop.h"
+
+/* KB classes counted, class 0 is no detection */
+#define PVP_NB_CLASSES               8
+
+/* Default minimum interval between BLE pattern notifications in ms */
+#define PVP_DEFAULT_NOTIFY_INTERVAL  1000
+
+/* Default KB classification rate */
+#define PVP_DEFAULT_FREQUENCY        100
+#define PVP_DEFAULT_INTERVAL         10
+
+/* Default duration of the classifier histogram buckets in s */
+#define PVP_DEFAULT_BUCKET_DURATION  60
+
+/* Maximum number of KB classifier results in a results record */
+#define PVP_BATCH_SIZE               32
+
+/* Storage of the KB classifier results */
+enum pvp_storage_mode {
+	/* One results record per batch of results */
+	PVP_STORAGE_EVENTS,
+	/* One histogram record per bucket */
+	PVP_STORAGE_HISTOGRAM,
+};
+
+/* Type of the records of the classifier storage */
+enum pvp_record_type {
+	PVP_RECORD_RESULTS = 1,
+	PVP_RECORD_HISTOGRAM,
+};
+
+/* Consecutive results of the KB classifier */
+struct pvp_results {
+	/* RTC time of the first result in s */
+	uint32_t start;
+	uint8_t count;
+	/* Class of each result, oldest first, class 0 is no detection.
+	 * Saturated to UINT8_MAX */
+	uint8_t labels[PVP_BATCH_SIZE];
+} __packed;
+
+/* Results of the KB classifier over a bucket */
+struct pvp_histogram {
+	/* RTC time of the bucket start in s */
+	uint32_t start;
+	/* Duration in s, shorter for the last bucket of a session */
+	uint16_t duration;
+	/* Results of each class, class 0 is no detection. Saturated to
+	 * UINT16_MAX */
+	uint16_t counts[PVP_NB_CLASSES];
+} __packed;
+
+/* Record of the PVP events storage, decoded by scripts/pvp_decode.py */
+struct pvp_record {
+	/* See enum pvp_record_type */
+	uint8_t type;
+	union {
+		struct pvp_results results;
+		struct pvp_histogram histogram;
+	};
+} __packed;
+
+#define PVP_RECORD_ELT_SIZE          sizeof(struct pvp_record)
+
+/* KB subscription rate */
+struct pvp_rate {
+	/* Sampling rate frequency in Hz */
+	uint16_t frequency;
+	/* Reporting interval in ms */
+	uint16_t interval;
+};
+
+struct pvp_rate_config {
+	struct pvp_rate active;
+	/* Rate used once no class is detected for idle_timeout ms, the active
+	 * rate is restored on the next detection */
+	struct pvp_rate idle;
+	/* 0 to stay at the active rate */
+	uint32_t idle_timeout;
+};
 
 /** PVP events generator init
- * This will start the required services and start sensor scanning.
+ * This will register to the sensor registry, init_done_cb is called once the
+ * KB is found. The classifier results are pushed in batches from the loop.
  */
-void pvp_events_generator_init(T_QUEUE queue, void (*init_done_cb)(void));
+void pvp_events_generator_init(T_QUEUE queue, xloop_t *loop,
+			       void (*init_done_cb)(void));
 
 /** PVP events generator start
  * This will subscribe to KB Algo.
@@ -45,8 +132,46 @@ void pvp_events_generator_init(T_QUEUE queue, void (*init_done_cb)(void));
 void pvp_events_generator_start(void);
 
 /** PVP events generator end
- * This will unsubscribe to KB Algo.
+ * This will unsubscribe to KB Algo and push the pending classifier results.
  */
 void pvp_events_generator_end(void);
 
+/** Set the KB classification rate.
+ * It applies at once if the KB is subscribed, else on the next start.
+ *
+ * @param config active and idle rates
+ * @return false if a rate in use has a null frequency
+ */
+bool pvp_events_generator_set_rate(const struct pvp_rate_config *config);
+
+/** Get the KB classification rate.
+ *
+ * @return the active and idle rates
+ */
+const struct pvp_rate_config *pvp_events_generator_get_rate(void);
+
+/** Set how the KB classifier results are stored.
+ * The current histogram bucket is stored before the change.
+ *
+ * @param mode one PVP event per result, or one histogram per bucket
+ * @param bucket_duration duration of the histogram buckets in s
+ * @return false if the bucket duration is null in histogram mode
+ */
+bool pvp_events_generator_set_storage(enum pvp_storage_mode mode,
+				      uint16_t bucket_duration);
+
+/** Set the minimum interval between BLE pattern notifications.
+ * Detections within the interval are notified together once it is over.
+ *
+ * @param interval interval in ms, 0 to notify each detection
+ */
+void pvp_events_generator_set_notify_interval(uint16_t interval);
+
+/** Get the number of detections of a KB class since boot.
+ *
+ * @param class_label KB class
+ * @return the number of detections
+ */
+uint32_t pvp_events_generator_get_count(uint8_t class_label);
+
 #endif
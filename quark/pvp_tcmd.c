@@ -0,0 +1,156 @@
+/*
+ * Copyright (c) 2016, Intel Corporation. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ * this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ * this list of conditions and the following disclaimer in the documentation
+ * and/or other materials provided with the distribution.
+ *
+ * 3. Neither the name of the copyright holder nor the names of its contributors
+ * may be used to endorse or promote products derived from this software without
+ * specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "infra/tcmd/handler.h"
+
+#include "pvp_events_generator.h"
+
+/*
+ * Set the minimum interval between BLE pattern notifications: pvp notify <ms>
+ *
+ * @param[in]   argc        Number of arguments in the Test Command (including group and name)
+ * @param[in]   argv        Table of null-terminated buffers containing the arguments
+ * @param[in]   ctx         The context to pass back to responses
+ */
+void pvp_tcmd_notify(int argc, char *argv[], struct tcmd_handler_ctx *ctx)
+{
+	if (argc != 3) {
+		TCMD_RSP_ERROR(ctx, "Usage: pvp notify <ms>");
+		return;
+	}
+
+	pvp_events_generator_set_notify_interval(strtoul(argv[2], NULL, 0));
+	TCMD_RSP_FINAL(ctx, NULL);
+}
+
+DECLARE_TEST_COMMAND(pvp, notify, pvp_tcmd_notify);
+
+/*
+ * Set the KB classification rate:
+ * pvp rate <frequency> <interval> [<idle_frequency> <idle_interval> <idle_timeout>]
+ * The idle rate is used once no class is detected for idle_timeout ms.
+ *
+ * @param[in]   argc        Number of arguments in the Test Command (including group and name)
+ * @param[in]   argv        Table of null-terminated buffers containing the arguments
+ * @param[in]   ctx         The context to pass back to responses
+ */
+void pvp_tcmd_rate(int argc, char *argv[], struct tcmd_handler_ctx *ctx)
+{
+	struct pvp_rate_config config;
+
+	if (argc != 4 && argc != 7)
+		goto print_help;
+
+	memset(&config, 0, sizeof(config));
+	config.active.frequency = strtoul(argv[2], NULL, 0);
+	config.active.interval = strtoul(argv[3], NULL, 0);
+	if (argc == 7) {
+		config.idle.frequency = strtoul(argv[4], NULL, 0);
+		config.idle.interval = strtoul(argv[5], NULL, 0);
+		config.idle_timeout = strtoul(argv[6], NULL, 0);
+	}
+	if (!pvp_events_generator_set_rate(&config))
+		goto print_help;
+
+	TCMD_RSP_FINAL(ctx, NULL);
+	return;
+
+print_help:
+	TCMD_RSP_ERROR(ctx, "Usage: pvp rate <freq> <interval> "
+		       "[<idle_freq> <idle_interval> <idle_timeout>]");
+}
+
+DECLARE_TEST_COMMAND(pvp, rate, pvp_tcmd_rate);
+
+/*
+ * Set how the KB classifier results are stored:
+ * pvp storage events|histogram [<bucket_duration>]
+ * events stores the results in records of up to 32 results, histogram one
+ * histogram of the results per bucket of the given duration in s.
+ *
+ * @param[in]   argc        Number of arguments in the Test Command (including group and name)
+ * @param[in]   argv        Table of null-terminated buffers containing the arguments
+ * @param[in]   ctx         The context to pass back to responses
+ */
+void pvp_tcmd_storage(int argc, char *argv[], struct tcmd_handler_ctx *ctx)
+{
+	enum pvp_storage_mode mode;
+
+	if (argc != 3 && argc != 4)
+		goto print_help;
+
+	if (!strcmp(argv[2], "events"))
+		mode = PVP_STORAGE_EVENTS;
+	else if (!strcmp(argv[2], "histogram"))
+		mode = PVP_STORAGE_HISTOGRAM;
+	else
+		goto print_help;
+
+	if (!pvp_events_generator_set_storage(mode, argc == 4 ?
+					      strtoul(argv[3], NULL, 0) :
+					      PVP_DEFAULT_BUCKET_DURATION))
+		goto print_help;
+
+	TCMD_RSP_FINAL(ctx, NULL);
+	return;
+
+print_help:
+	TCMD_RSP_ERROR(ctx, "Usage: pvp storage events|histogram [<bucket_s>]");
+}
+
+DECLARE_TEST_COMMAND(pvp, storage, pvp_tcmd_storage);
+
+/*
+ * Print the number of detections of each KB class: pvp counts
+ *
+ * @param[in]   argc        Number of arguments in the Test Command (including group and name)
+ * @param[in]   argv        Table of null-terminated buffers containing the arguments
+ * @param[in]   ctx         The context to pass back to responses
+ */
+void pvp_tcmd_counts(int argc, char *argv[], struct tcmd_handler_ctx *ctx)
+{
+	char buf[32];
+	uint8_t i;
+
+	for (i = 1; i < PVP_NB_CLASSES - 1; i++) {
+		snprintf(buf, sizeof(buf), "class %d: %u", i,
+			 (unsigned int)pvp_events_generator_get_count(i));
+		TCMD_RSP_PROVISIONAL(ctx, buf);
+	}
+	snprintf(buf, sizeof(buf), "class %d: %u", i,
+		 (unsigned int)pvp_events_generator_get_count(i));
+	TCMD_RSP_FINAL(ctx, buf);
+}
+
+DECLARE_TEST_COMMAND(pvp, counts, pvp_tcmd_counts);
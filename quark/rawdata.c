@@ -38,6 +38,7 @@
 
 #include "cir_storage.h"
 #include "services/circular_storage_service/circular_storage_service.h"
+#include "services/properties_service/properties_service_api.h"
 #include "drivers/data_type.h"
 #include "project_mapping.h"
 #include "rawdata.h"
@@ -47,6 +48,20 @@
 #include "lib/ble/ble_app.h"
 #include "iasp.h"
 
+/* USB */
+#include "rawdata_usb.h"
+
+/* Sensor core raw data collector */
+#include "rawdata_collector.h"
+
+/* Sensor handles, shared with the other consumers */
+#include "sensor_registry.h"
+#include "binlog.h"
+#include "msg_lanes.h"
+#include "boot_timeline.h"
+#include "project_properties.h"
+#include "rawdata_trace.h"
+
 /* IQs */
 #include "iq/raw_sensor_streaming.h"
 #include "itm/itm.h"
@@ -54,24 +69,71 @@
 /* Maximum expected latency in ms */
 #define MAXIMUM_LATENCY  100
 
-/* Non official channel */
+/* Number of samples read at once from the BMI160 hardware FIFO in FIFO mode.
+ * The gyro reports of the sensor core must fit in the 512 bytes blocks of its
+ * memory pool, which binds well below the 1 kB of the FIFO */
+#define FIFO_MAX_SAMPLES       32
+
+/* Non official channels */
 #define IASP_RAWDATA_CHANNEL    0x1C
+#define IASP_RAWDATA_STATUS_CHANNEL    0x1D
+
+/* Minimum delay between two drain progress reports in ms */
+#define DRAIN_REPORT_PERIOD  1000
 
 static bool con_opened = false;
+static bool status_con_opened = false;
 static uint8_t nb_pending_raw_data = 0;
 static uint8_t nb_subscribe_expected = 0;
 static uint8_t nb_subscribe_rsp = 0;
+/* Reports are still collected until all the sensors are unsubscribed */
+static uint8_t nb_unsubscribe_pending = 0;
 static bool buffer_empty = false;
 static bool use_stream = false;
+static enum rawdata_transport transport = RAWDATA_TRANSPORT_NONE;
+/* Set while a request of the raw sensor streaming IQ waits for a response */
+static bool iq_request = false;
+
+/* Number of records pushed in the circular storage and not yet streamed */
+static uint32_t nb_stored_records = 0;
+/* Number of push requests waiting for the storage response */
+static uint8_t nb_pending_push = 0;
+
+/* Records not in the storage yet */
+#define NB_UNSTORED_RECORDS  (nb_pending_push + pool.nb_staged)
+
+/* Background drain of a stopped streaming session */
+static struct drain_state {
+	bool running;
+	/* Records left when the session was stopped */
+	uint32_t start_records;
+	/* Records streamed since the session was stopped */
+	uint32_t sent_records;
+	uint32_t start_time;
+	uint32_t last_report_time;
+} drain;
+
+/* Minimum delay between two telemetry updates in ms */
+#define TELEMETRY_PERIOD  1000
+
+/* Streaming telemetry, rates are computed from the bytes counted since the
+ * last update */
+static struct telemetry_state {
+	uint32_t sampled_bytes;
+	uint32_t stored_bytes;
+	uint32_t streamed_bytes;
+	uint32_t last_update_time;
+	struct rawdata_stats stats;
+} telemetry;
+
+/* Requested BLE connection interval in 1.25 ms units, 0 if default */
+static uint16_t requested_conn_interval = 0;
 
 /* Client */
 static cfw_client_t *client = NULL;
 
-/* Sensors client */
-static cfw_service_conn_t *sensor_service_conn = NULL;
-
-/* Sensor handles */
-static sensor_service_t handles[ON_BOARD_SENSOR_TYPE_END + 1] = { NULL };
+/* Raw data collector client */
+static cfw_service_conn_t *collector_conn = NULL;
 
 static cfw_service_conn_t *circular_storage_service_conn = NULL;
 static cir_storage_t *storage = NULL;
@@ -79,30 +141,203 @@ static bool session_running = false;
 static struct sensor_subscribe_parameters {
 	uint32_t sensor_mask;
 	uint32_t frequency;
+	enum rawdata_mode mode;
+	uint16_t feature_window;
+	uint16_t burst_period;
+	uint16_t max_latency;
+	struct rawdata_sensor_rate rates[RAWDATA_MAX_SENSORS];
 } sensor_parameter;
 
-static uint32_t sampling_interval = 0;
+/* Maximum latency of the sessions started by the IQ or the TCMD */
+static uint16_t default_max_latency = 0;
 
-/* This structure represents the data stored in the circular storage */
-struct stored_data {
-	uint32_t timestamp;
-	/* Data collected between timestamp and timestamp + interval/2 */
-	uint8_t data[RAW_STORAGE_ELT_SIZE - sizeof(uint32_t) - sizeof(uint8_t)];
-	/* Actual size of the data = timestamp + valid portion of data array */
-	uint8_t datasize;
+/* Records are held in the storage and streamed in bursts when the latency
+ * budget of the session allows it */
+#define STREAM_BURST_RECORDS  16
+
+static struct stream_hold_state {
+	/* Maximum time records are held, 0 to stream them once stored */
+	uint16_t duration;
+	bool burst;
+	/* End of the previous burst */
+	uint32_t start;
+	/* Set while the timer of the end of the hold runs */
+	bool armed;
+} hold;
+
+static xloop_t *main_loop = NULL;
+static T_TIMER hold_timer = NULL;
+
+/* Per sensor rates of the sessions started by the IQ or the TCMD */
+static struct rawdata_sensor_rate sensor_rates[RAWDATA_MAX_SENSORS];
+
+/* Records are staged in a pool reserved to the raw data and pushed to the
+ * storage at most RAWDATA_MAX_PENDING_PUSH at a time */
+#define RAWDATA_POOL_RECORDS      16
+#define RAWDATA_MAX_PENDING_PUSH  4
+/* The throttle policy halves the rate above the high watermark, and doubles
+ * it below the low one once it is held for RAWDATA_THROTTLE_HOLD ms */
+#define RAWDATA_POOL_HIGH         (RAWDATA_POOL_RECORDS * 3 / 4)
+#define RAWDATA_POOL_LOW          (RAWDATA_POOL_RECORDS / 4)
+#define RAWDATA_THROTTLE_HOLD     1000
+
+static struct record_pool {
+	struct stored_data records[RAWDATA_POOL_RECORDS];
+	/* Bit n is set if records[n] is free */
+	uint32_t free_mask;
+	uint8_t nb_used;
+	/* Records waiting for a push slot, oldest first */
+	struct stored_data *staged[RAWDATA_POOL_RECORDS];
+	uint8_t staged_head;
+	uint8_t nb_staged;
+	enum rawdata_drop_policy policy;
+	uint8_t throttle;
+	uint32_t throttle_time;
+} pool = {
+	.free_mask = (1 << RAWDATA_POOL_RECORDS) - 1,
+	.policy = RAWDATA_DROP_NEWEST,
 };
-STATIC_ASSERT(sizeof(struct stored_data) == RAW_STORAGE_ELT_SIZE);
 
-static struct stored_data tmp_data;
-static uint32_t data_index = 0;
+STATIC_ASSERT(RAWDATA_POOL_RECORDS < 32);
+
+/* In burst mode the staged records are pushed once half of the pool is used,
+ * the other half takes the records received during the burst. This half is
+ * all the RAM a burst period has: the sensor core only holds one batch, so
+ * the period must not last longer than RAWDATA_BURST_RECORDS records */
+#define RAWDATA_BURST_RECORDS     (RAWDATA_POOL_RECORDS / 2)
+#define RAWDATA_BURST_BYTES       (RAWDATA_BURST_RECORDS * \
+				   (sizeof(((struct stored_data *)0)->data) - \
+				    RAWDATA_RECORD_TLV_HEADER))
+
+static struct burst_state {
+	/* Staged records are held until the next burst */
+	bool enabled;
+	/* Set until the staged records are all pushed */
+	bool running;
+	uint16_t period;
+	/* End of the previous burst */
+	uint32_t last_time;
+	/* Set while the timer of the end of the period runs */
+	bool armed;
+} burst;
+
+static T_TIMER burst_timer = NULL;
+
+/* Period of the time anchors stored with the records in ms */
+#define TIME_ANCHOR_PERIOD  60000
 
-/* 1 byte for type and 1 byte for length */
-#define DATA_HEADER_SIZE    (2 * sizeof(uint8_t))
+static struct time_anchor_state {
+	/* Store an anchor before the next records */
+	bool needed;
+	uint32_t last_time;
+} anchor;
+
+/* Last session, kept in the properties service. A session without streaming
+ * still running at reboot is resumed as soon as its sensors, the storage and
+ * the collector are available, keeping the records already stored */
+struct saved_session {
+	uint8_t running;
+	uint8_t transport;
+	uint8_t mode;
+	uint32_t sensor_mask;
+	uint32_t frequency;
+	uint16_t feature_window;
+	uint16_t burst_period;
+	uint16_t max_latency;
+	struct rawdata_sensor_rate rates[RAWDATA_MAX_SENSORS];
+};
+
+static struct saved_session_state {
+	struct saved_session session;
+	/* Set once the property is read, and if it exists */
+	bool read;
+	bool stored;
+	bool resume_pending;
+} saved;
+
+static cfw_service_conn_t *properties_service_conn = NULL;
+
+/* The records are packed by the raw data collector of the sensor core */
+STATIC_ASSERT(sizeof(struct stored_data) == RAW_STORAGE_ELT_SIZE);
 
 /* Define the maximum number of pending IASP messages */
 #define RAWDATA_IASP_MAX_MSGS 3
 
+/* Status frames sent on the status channel */
+#define RAWDATA_STATUS_DRAIN  0x01
+#define RAWDATA_STATUS_STATS  0x02
+
+/* Drain progress report */
+struct rawdata_drain_status {
+	uint8_t type;
+	/* Records still to be streamed */
+	uint32_t records_left;
+	/* Estimated time to stream them in ms, 0 if unknown */
+	uint32_t eta;
+} __packed;
+
+/* Streaming telemetry report, see struct rawdata_stats */
+struct rawdata_stats_status {
+	uint8_t type;
+	uint32_t sampled_rate;
+	uint32_t stored_rate;
+	uint32_t streamed_rate;
+	uint32_t backlog;
+	uint32_t dropped_reports;
+	uint32_t dropped_records;
+	uint8_t pending_push_max;
+	uint8_t pending_tx_max;
+	uint8_t unacked_max;
+	uint16_t requested_conn_interval;
+	uint32_t pool_dropped_newest;
+	uint32_t pool_dropped_oldest;
+	uint8_t pool_used_max;
+	uint8_t throttle;
+	uint32_t bursts;
+} __packed;
+
+/* Frames received from the host on the raw data channel */
+#define RAWDATA_HOST_ACK  0x01
+
+/* Cumulative acknowledgement: number of records received by the host since
+ * the raw data channel was opened */
+struct rawdata_host_ack {
+	uint8_t type;
+	uint32_t seq;
+} __packed;
+
+/* Records sent but not acknowledged by the host, kept in the storage */
+#define RAWDATA_ACK_WINDOW    16
+/* Maximum number of pending IASP messages once the host sends acks */
+#define RAWDATA_ACK_MAX_MSGS  8
+
+/* Host acknowledgement state. Sequence numbers are absolute, the host
+ * counts from base which is reset when the channel is opened. Without acks
+ * the records are cleared from the storage once sent. With acks they stay
+ * stored until acknowledged: the next records are peeked after them, and the
+ * unacknowledged ones are sent again on the next connection. */
+static struct ack_state {
+	/* Set on the first ack: legacy hosts keep the unacknowledged flow */
+	bool enabled;
+	uint32_t base;
+	/* Records sent on the raw data channel */
+	uint32_t tx_seq;
+	/* Records acknowledged by the host */
+	uint32_t acked_seq;
+	/* Records cleared from the storage, or being cleared */
+	uint32_t cleared_seq;
+	/* Clear requests waiting for the storage response */
+	uint8_t nb_clear_pending;
+} ack;
+
+/* Record peeked behind the ones not acknowledged yet */
+static struct stored_data peek_buffer;
+
+/* Set while a peek request waits for the storage response */
+static bool peek_pending = false;
+
 void iasp_rawdata_channel_handler(const struct iasp_event *p_iasp_evt);
+void iasp_rawdata_status_channel_handler(const struct iasp_event *p_iasp_evt);
 
 struct iasp_channel raw_data_iasp = {
 	.id = IASP_RAWDATA_CHANNEL,
@@ -110,19 +345,387 @@ struct iasp_channel raw_data_iasp = {
 	.next = NULL,
 };
 
-static void check_end_of_session(void)
+struct iasp_channel raw_data_status_iasp = {
+	.id = IASP_RAWDATA_STATUS_CHANNEL,
+	.handler = iasp_rawdata_status_channel_handler,
+	.next = NULL,
+};
+
+static void send_response(uint8_t status)
 {
-	/* During streaming, If no more BLE ack pending and
-	 * no more data to pull  and
-	 * session is over => trig response */
-	if (use_stream && !nb_pending_raw_data && buffer_empty &&
-	    !session_running) {
-		/* Restore the default BLE connection parameters and ack the stop
-		 * request */
-		pr_info(LOG_MODULE_MAIN, "Raw data session is over");
-		raw_sensor_streaming_iq_send_itm_response(
-			TOPIC_STATUS_OK);
+	if (iq_request)
+		raw_sensor_streaming_iq_send_itm_response(status);
+	iq_request = false;
+}
+
+static bool transport_opened(enum rawdata_transport t)
+{
+	switch (t) {
+	case RAWDATA_TRANSPORT_IASP:
+		return con_opened;
+	case RAWDATA_TRANSPORT_USB:
+		return rawdata_usb_is_opened();
+	default:
+		return false;
+	}
+}
+
+static int transport_write(struct stored_data *p_data)
+{
+	int rv;
+
+	if (transport == RAWDATA_TRANSPORT_USB)
+		rv = rawdata_usb_write(p_data, p_data->datasize);
+	else
+		rv = iasp_write(NULL, IASP_RAWDATA_CHANNEL, p_data,
+				p_data->datasize, NULL, 0);
+	/* A failed write has no completion */
+	if (rv < 0)
+		RAWDATA_TRACE(TRANSPORT_FAIL, -rv);
+	else
+		RAWDATA_TRACE(TRANSPORT_WRITE, rv);
+	return rv;
+}
+
+static void restore_default_conn(void)
+{
+	if (transport == RAWDATA_TRANSPORT_IASP) {
 		ble_app_restore_default_conn();
+		requested_conn_interval = 0;
+	}
+}
+
+static void fill_stats(struct rawdata_stats *stats)
+{
+	*stats = telemetry.stats;
+	stats->backlog = nb_stored_records + NB_UNSTORED_RECORDS;
+	stats->requested_conn_interval = requested_conn_interval;
+}
+
+/* Compute the rates once per period, and report them on the status channel
+ * while data is streamed. Called on data events, so nothing runs when the
+ * raw data is idle. */
+static void update_telemetry(void)
+{
+	struct rawdata_stats_status status = { .type = RAWDATA_STATUS_STATS };
+	struct rawdata_stats stats;
+	uint32_t now = get_uptime_ms();
+	uint32_t elapsed = now - telemetry.last_update_time;
+
+	if (elapsed < TELEMETRY_PERIOD)
+		return;
+
+	telemetry.stats.sampled_rate = telemetry.sampled_bytes * 1000 / elapsed;
+	telemetry.stats.stored_rate = telemetry.stored_bytes * 1000 / elapsed;
+	telemetry.stats.streamed_rate = telemetry.streamed_bytes * 1000 /
+					elapsed;
+	telemetry.sampled_bytes = 0;
+	telemetry.stored_bytes = 0;
+	telemetry.streamed_bytes = 0;
+	telemetry.last_update_time = now;
+
+	if (!status_con_opened || !use_stream ||
+	    (!session_running && !drain.running))
+		return;
+
+	fill_stats(&stats);
+	status.sampled_rate = stats.sampled_rate;
+	status.stored_rate = stats.stored_rate;
+	status.streamed_rate = stats.streamed_rate;
+	status.backlog = stats.backlog;
+	status.dropped_reports = stats.dropped_reports;
+	status.dropped_records = stats.dropped_records;
+	status.pending_push_max = stats.pending_push_max;
+	status.pending_tx_max = stats.pending_tx_max;
+	status.unacked_max = stats.unacked_max;
+	status.requested_conn_interval = stats.requested_conn_interval;
+	status.pool_dropped_newest = stats.pool_dropped_newest;
+	status.pool_dropped_oldest = stats.pool_dropped_oldest;
+	status.pool_used_max = stats.pool_used_max;
+	status.throttle = stats.throttle;
+	status.bursts = stats.bursts;
+	iasp_write(NULL, IASP_RAWDATA_STATUS_CHANNEL, &status, sizeof(status),
+		   NULL, 0);
+}
+
+void rawdata_get_stats(struct rawdata_stats *stats)
+{
+	update_telemetry();
+	fill_stats(stats);
+}
+
+static void report_drain_progress(void)
+{
+	struct rawdata_drain_status status = {
+		.type = RAWDATA_STATUS_DRAIN,
+		.records_left = 0,
+		.eta = 0,
+	};
+	uint32_t now = get_uptime_ms();
+
+	/* Records of a new session are not part of the drain */
+	if (drain.start_records > drain.sent_records)
+		status.records_left = drain.start_records - drain.sent_records;
+
+	/* Extrapolate from the rate observed since the session was stopped */
+	if (drain.sent_records)
+		status.eta = (uint64_t)status.records_left *
+			     (now - drain.start_time) / drain.sent_records;
+
+	drain.last_report_time = now;
+	BINLOG(RAWDATA_DRAIN_PROGRESS, status.records_left, status.eta);
+	if (status_con_opened)
+		iasp_write(NULL, IASP_RAWDATA_STATUS_CHANNEL, &status,
+			   sizeof(status), NULL, 0);
+}
+
+static void check_end_of_drain(void)
+{
+	if (!drain.running)
+		return;
+
+	/* During the drain, If no more BLE ack pending and
+	 * no more data to pull => the previous session is fully streamed.
+	 * With host acks, the streamed records must also be acknowledged */
+	if ((!ack.enabled || ack.tx_seq == ack.acked_seq) &&
+	    ((!nb_pending_raw_data && !NB_UNSTORED_RECORDS && buffer_empty) ||
+	     drain.sent_records >= drain.start_records)) {
+		drain.running = false;
+		pr_info(LOG_MODULE_MAIN, "Raw data drain is over");
+		report_drain_progress();
+		/* Restore the default BLE connection parameters unless a new
+		 * session is streaming */
+		if (!session_running) {
+			restore_default_conn();
+			/* Nothing left to stream once the port reopens */
+			if (transport == RAWDATA_TRANSPORT_USB)
+				rawdata_usb_watch(false);
+		}
+	} else if (get_uptime_ms() - drain.last_report_time >=
+		   DRAIN_REPORT_PERIOD) {
+		report_drain_progress();
+	}
+}
+
+/* Check if one more record can be sent on the transport */
+static bool can_send(void)
+{
+	if (!use_stream || !transport_opened(transport))
+		return false;
+	/* The records of a stopped session are drained at once */
+	if (session_running && hold.duration && !hold.burst)
+		return false;
+	if (!ack.enabled)
+		return nb_pending_raw_data < RAWDATA_IASP_MAX_MSGS;
+	return (nb_pending_raw_data < RAWDATA_ACK_MAX_MSGS) &&
+	       (ack.tx_seq - ack.acked_seq < RAWDATA_ACK_WINDOW);
+}
+
+/* Start a streaming burst once enough records are held, or once the oldest
+ * one is about to exceed the latency budget. The end of the hold is timed,
+ * held records do not wait for the next one */
+static void check_stream_hold(void)
+{
+	uint32_t held;
+
+	if (!hold.duration || hold.burst)
+		return;
+	held = get_uptime_ms() - hold.start;
+	if ((nb_stored_records >= STREAM_BURST_RECORDS) ||
+	    (held >= hold.duration)) {
+		hold.burst = true;
+		if (hold.armed) {
+			timer_stop(hold_timer, NULL);
+			hold.armed = false;
+		}
+	} else if (nb_stored_records && !hold.armed && hold_timer) {
+		hold.armed = true;
+		timer_start(hold_timer, hold.duration - held, NULL);
+	}
+}
+
+static void handle_peek(int status, struct stored_data *p_data);
+
+/* The storage service only peeks the oldest record, the ones stored behind
+ * the records waiting for an ack are read from the storage directly */
+static int peek_job(void *param)
+{
+	cir_storage_err_t err;
+
+	err = cir_storage_peek(storage, ack.tx_seq - ack.cleared_seq,
+			       (uint8_t *)&peek_buffer, sizeof(peek_buffer));
+	handle_peek(err == CBUFFER_STORAGE_SUCCESS ? DRV_RC_OK : err,
+		    &peek_buffer);
+	return 0;
+}
+
+/* Peek the next record to stream, if none is already requested */
+static void peek_more(void)
+{
+	uint32_t offset = ack.tx_seq - ack.cleared_seq;
+
+	if (peek_pending || !can_send())
+		return;
+	/* The offset is only known once the pending clears are done, the
+	 * service peek is handled after them */
+	if (offset && ack.nb_clear_pending)
+		return;
+	peek_pending = true;
+	RAWDATA_TRACE(PEEK_SENT, nb_stored_records);
+	if (offset)
+		xloop_post_func(main_loop, peek_job, NULL);
+	else
+		circular_storage_service_peek(circular_storage_service_conn,
+					      storage, NULL);
+}
+
+/* Clear the acknowledged records from the storage in one request */
+static void clear_acked(void)
+{
+	uint32_t count = ack.acked_seq - ack.cleared_seq;
+
+	if (!count || peek_pending)
+		return;
+	ack.cleared_seq = ack.acked_seq;
+	ack.nb_clear_pending++;
+	RAWDATA_TRACE(CLEAR_SENT, count);
+	circular_storage_service_clear(circular_storage_service_conn, storage,
+				       count, &ack);
+}
+
+static void handle_peek(int status, struct stored_data *p_data)
+{
+	peek_pending = false;
+	RAWDATA_TRACE(PEEK_ACKED, status);
+	if (status == DRV_RC_OK) {
+		int rv;
+
+		buffer_empty = false;
+		rv = transport_write(p_data);
+		if (rv >= 0) {
+			ack.tx_seq++;
+			/* Without host acks the record is cleared once sent */
+			if (!ack.enabled)
+				ack.acked_seq = ack.tx_seq;
+			telemetry.stats.unacked_max = MAX(
+				telemetry.stats.unacked_max,
+				ack.tx_seq - ack.acked_seq);
+			if (nb_stored_records)
+				nb_stored_records--;
+			drain.sent_records++;
+			telemetry.streamed_bytes += p_data->datasize;
+
+			/* Increase the number of BLE request */
+			nb_pending_raw_data++;
+			telemetry.stats.pending_tx_max = MAX(
+				telemetry.stats.pending_tx_max,
+				nb_pending_raw_data);
+		} else {
+			BINLOG(RAWDATA_WRITE_FAILURE, rv);
+		}
+		clear_acked();
+		/* try to push more data */
+		peek_more();
+	} else {
+		buffer_empty = true;
+		/* Hold the next records until the next burst */
+		hold.burst = false;
+		hold.start = get_uptime_ms();
+		clear_acked();
+		/* Check end of drain */
+		check_end_of_drain();
+	}
+}
+
+static int hold_job(void *param)
+{
+	hold.armed = false;
+	check_stream_hold();
+	if (session_running || drain.running)
+		peek_more();
+	return 0;
+}
+
+static void hold_timer_cb(void *param)
+{
+	xloop_post_func(main_loop, hold_job, NULL);
+}
+
+static void handle_host_ack(const uint8_t *data, uint16_t len)
+{
+	struct rawdata_host_ack host_ack;
+	uint32_t seq;
+
+	if (len < sizeof(host_ack) || data[0] != RAWDATA_HOST_ACK)
+		return;
+	memcpy(&host_ack, data, sizeof(host_ack));
+	seq = ack.base + host_ack.seq;
+	/* The records sent before the first ack are already cleared */
+	ack.enabled = true;
+
+	/* Ignore the acks of unknown or already acknowledged records */
+	if (seq - ack.acked_seq > ack.tx_seq - ack.acked_seq) {
+		BINLOG(RAWDATA_ACK_IGNORED, host_ack.seq);
+		return;
+	}
+	ack.acked_seq = seq;
+
+	clear_acked();
+	peek_more();
+	check_end_of_drain();
+}
+
+static void start_drain(void)
+{
+	drain.running = true;
+	drain.start_records = nb_stored_records + NB_UNSTORED_RECORDS;
+	drain.sent_records = 0;
+	drain.start_time = get_uptime_ms();
+	drain.last_report_time = drain.start_time;
+	peek_more();
+	check_end_of_drain();
+}
+
+void iasp_rawdata_status_channel_handler(const struct iasp_event *p_iasp_evt)
+{
+	switch (p_iasp_evt->event) {
+	case IASP_OPEN:
+		status_con_opened = true;
+		break;
+	case IASP_CLOSE:
+		status_con_opened = false;
+		break;
+	default:
+		break;
+	}
+}
+
+/* A record has been sent on the transport */
+static void handle_tx_complete(void)
+{
+	/* Decrease the number of pending request */
+	nb_pending_raw_data--;
+	RAWDATA_TRACE(TX_COMPLETE, nb_pending_raw_data);
+	/* resume peeking the data */
+	peek_more();
+	update_telemetry();
+	/* Check end of drain */
+	check_end_of_drain();
+}
+
+/* The transport of the session has been closed */
+static void transport_closed(void)
+{
+	/* Stop raw data collection */
+	if (session_running && use_stream)
+		rawdata_end();
+	/* The remaining data stays in the storage */
+	if (drain.running) {
+		pr_info(LOG_MODULE_MAIN, "Raw data drain aborted, %d records left",
+			nb_stored_records);
+		drain.running = false;
+		/* Restore the default BLE connection parameters */
+		restore_default_conn();
 	}
 }
 
@@ -132,35 +735,33 @@ void iasp_rawdata_channel_handler(const struct iasp_event *p_iasp_evt)
 	case IASP_OPEN:
 		pr_debug(LOG_MODULE_MAIN, "CONN IASP OPEN...");
 		con_opened = true;
+		/* The host counts the records from the channel opening */
+		ack.enabled = false;
+		ack.base = ack.tx_seq;
 		break;
 
 	case IASP_CLOSE:
 		pr_debug(LOG_MODULE_MAIN, "CONN IASP CLOSE...");
 		con_opened = false;
-		/* Restore the default BLE connection parameters if session running */
-		if (session_running && use_stream) {
-			ble_app_restore_default_conn();
-			/* Stop raw data collection when BLE connection is closed */
-			rawdata_end();
+		/* Records not acknowledged by the host are still stored, they
+		 * are streamed again in order on the next connection */
+		if (ack.enabled && ack.tx_seq != ack.acked_seq) {
+			BINLOG(RAWDATA_RESEND, ack.tx_seq - ack.acked_seq);
+			nb_stored_records += ack.tx_seq - ack.acked_seq;
+			ack.tx_seq = ack.acked_seq;
 		}
+		ack.enabled = false;
+		if (transport == RAWDATA_TRANSPORT_IASP)
+			transport_closed();
 		break;
 
 	case IASP_RX_COMPLETE:
+		handle_host_ack(p_iasp_evt->p_data, p_iasp_evt->len);
 		break;
 
 	case IASP_TX_COMPLETE:
-		if ((nb_pending_raw_data >= RAWDATA_IASP_MAX_MSGS) &&
-		    con_opened) {
-			/* resume peeking the data */
-			circular_storage_service_peek(
-				circular_storage_service_conn,
-				storage,
-				NULL);
-		}
-		/* Decrease the number of pending request */
-		nb_pending_raw_data--;
-		/* Check end of session */
-		check_end_of_session();
+		if (transport == RAWDATA_TRANSPORT_IASP)
+			handle_tx_complete();
 		break;
 
 	default:
@@ -168,133 +769,481 @@ void iasp_rawdata_channel_handler(const struct iasp_event *p_iasp_evt)
 	}
 }
 
-static void push_data(struct stored_data *ptr, uint32_t data_len)
+static struct stored_data *pool_alloc(void)
+{
+	uint8_t i;
+
+	if (!pool.free_mask)
+		return NULL;
+	for (i = 0; !(pool.free_mask & (1 << i)); i++)
+		;
+	pool.free_mask &= ~(1 << i);
+	pool.nb_used++;
+	telemetry.stats.pool_used_max = MAX(telemetry.stats.pool_used_max,
+					    pool.nb_used);
+	return &pool.records[i];
+}
+
+static void pool_free(struct stored_data *record)
+{
+	pool.free_mask |= 1 << (record - pool.records);
+	pool.nb_used--;
+}
+
+static bool is_pool_record(const void *ptr)
+{
+	return ((const uint8_t *)ptr >= (const uint8_t *)pool.records) &&
+	       ((const uint8_t *)ptr < (const uint8_t *)&pool.records[
+		       RAWDATA_POOL_RECORDS]);
+}
+
+static struct stored_data *unstage(void)
+{
+	struct stored_data *record = pool.staged[pool.staged_head];
+
+	pool.staged_head = (pool.staged_head + 1) % RAWDATA_POOL_RECORDS;
+	pool.nb_staged--;
+	return record;
+}
+
+/* Push the staged records while push slots are free */
+static void push_staged(void)
+{
+	struct stored_data *record;
+
+	if (burst.enabled && !burst.running) {
+		uint32_t elapsed = get_uptime_ms() - burst.last_time;
+
+		if (!pool.nb_staged)
+			return;
+		if (pool.nb_staged < RAWDATA_BURST_RECORDS &&
+		    elapsed < burst.period) {
+			/* Start the burst at the end of the period even if no
+			 * other record comes */
+			if (!burst.armed && burst_timer) {
+				burst.armed = true;
+				timer_start(burst_timer, burst.period - elapsed,
+					    NULL);
+			}
+			return;
+		}
+		if (burst.armed) {
+			burst.armed = false;
+			timer_stop(burst_timer, NULL);
+		}
+		burst.running = true;
+		telemetry.stats.bursts++;
+	}
+
+	while (pool.nb_staged && nb_pending_push < RAWDATA_MAX_PENDING_PUSH) {
+		record = unstage();
+		circular_storage_service_push(circular_storage_service_conn,
+					      (void *)record, storage, record);
+		nb_pending_push++;
+		RAWDATA_TRACE(PUSH_SENT, nb_pending_push);
+		telemetry.stats.pending_push_max =
+			MAX(telemetry.stats.pending_push_max, nb_pending_push);
+	}
+
+	if (burst.running && !pool.nb_staged) {
+		burst.running = false;
+		burst.last_time = get_uptime_ms();
+	}
+}
+
+static int burst_job(void *param)
+{
+	burst.armed = false;
+	push_staged();
+	return 0;
+}
+
+static void burst_timer_cb(void *param)
+{
+	xloop_post_func(main_loop, burst_job, NULL);
+}
+
+static uint8_t sample_size(uint8_t sensor_type)
+{
+	switch (sensor_type) {
+	case SENSOR_ACCELEROMETER:
+		return RAWDATA_ACCEL_SAMPLE_SIZE;
+	case SENSOR_GYROSCOPE:
+		return RAWDATA_GYRO_SAMPLE_SIZE;
+	default:
+		return 0;
+	}
+}
+
+/* Sampling rate frequency of a sensor of the session */
+static uint32_t sensor_frequency(const struct rawdata_session_params *params,
+				 uint8_t type)
+{
+	return params->rates && params->rates[type].frequency ?
+	       params->rates[type].frequency : params->frequency;
+}
+
+/* Longest burst period whose samples fit in RAWDATA_BURST_RECORDS records */
+static uint16_t burst_max_period(const struct rawdata_session_params *params)
 {
-	uint8_t datasize = offsetof(struct stored_data, data) + data_len;
-	struct stored_data *data_to_save = balloc(RAW_STORAGE_ELT_SIZE, NULL);
+	uint32_t bytes_per_s = 0;
+	uint32_t tmp_mask = params->sensor_mask;
+	uint8_t i = 0;
+
+	while (tmp_mask) {
+		if (tmp_mask & 1)
+			bytes_per_s += sensor_frequency(params, i) *
+				       sample_size(i);
+		i++;
+		tmp_mask = params->sensor_mask >> i;
+	}
+	if (!bytes_per_s)
+		return UINT16_MAX;
+	return MIN((uint32_t)RAWDATA_BURST_BYTES * 1000 / bytes_per_s,
+		   UINT16_MAX);
+}
+
+/* The features of a window count its samples on 16 bits */
+static bool feature_window_fits(const struct rawdata_session_params *params,
+				uint16_t window)
+{
+	uint32_t tmp_mask = params->sensor_mask;
+	uint8_t i = 0;
+
+	while (tmp_mask) {
+		if ((tmp_mask & 1) && sample_size(i) &&
+		    (uint64_t)sensor_frequency(params, i) * window / 1000 >
+		    UINT16_MAX)
+			return false;
+		i++;
+		tmp_mask = params->sensor_mask >> i;
+	}
+	return true;
+}
+
+/* Adapt the sampling rate of the sensor core to the pool usage */
+static void update_throttle(void)
+{
+	uint8_t throttle = pool.throttle;
+
+	if (pool.policy != RAWDATA_DROP_THROTTLE && !pool.throttle)
+		return;
+
+	if (pool.policy == RAWDATA_DROP_THROTTLE &&
+	    pool.nb_used >= RAWDATA_POOL_HIGH &&
+	    pool.throttle < RAWDATA_COLLECTOR_MAX_THROTTLE)
+		throttle++;
+	else if ((pool.policy != RAWDATA_DROP_THROTTLE ||
+		  pool.nb_used <= RAWDATA_POOL_LOW) && pool.throttle)
+		throttle--;
+
+	/* Changes are held to let the new rate reach the pool */
+	if (throttle == pool.throttle ||
+	    get_uptime_ms() - pool.throttle_time < RAWDATA_THROTTLE_HOLD)
+		return;
+
+	pool.throttle = throttle;
+	pool.throttle_time = get_uptime_ms();
+	telemetry.stats.throttle = throttle;
+	rawdata_collector_throttle(collector_conn, NULL, throttle);
+	BINLOG(RAWDATA_THROTTLE, 1 << throttle);
+}
+
+/* Push a record packed by the raw data collector, datasize bytes long */
+static void push_data(const uint8_t *record, uint8_t datasize)
+{
+	struct stored_data *data_to_save = pool_alloc();
+
+	if (!data_to_save) {
+		if (pool.policy == RAWDATA_DROP_OLDEST && pool.nb_staged) {
+			data_to_save = unstage();
+			telemetry.stats.pool_dropped_oldest++;
+			RAWDATA_TRACE(RECORD_DROPPED, pool.nb_staged);
+		} else {
+			telemetry.stats.pool_dropped_newest++;
+			RAWDATA_TRACE(RECORD_DROPPED, pool.nb_staged);
+			return;
+		}
+	}
 
 	/* Only copy the relevant part of the structure */
-	memcpy(data_to_save, ptr, datasize);
+	memcpy(data_to_save, record, datasize);
 
 	/* Update the size in the structure to save in the NVM */
 	data_to_save->datasize = datasize;
 
-	circular_storage_service_push(circular_storage_service_conn,
-				      (void *)data_to_save,
-				      storage,
-				      data_to_save);
-}
-
-/* Aggregate data sensor and push them */
-static void aggregate_and_dump(sensor_service_subscribe_data_event_t *p_evt)
-{
-	sensor_service_sensor_data_header_t *p_data_header =
-		&p_evt->sensor_data_header;
-	uint8_t type = GET_SENSOR_TYPE(p_evt->handle);
-	uint8_t data_len = p_data_header->data_length;
-
-	if (session_running && storage) {
-		/* data_index is null when it is the first element */
-		if (!data_index) {
-			tmp_data.timestamp = p_data_header->timestamp;
-			/* if timestamp change or there is not enough space to set sensor data:
-			 * push data and reset timestamp and data_index */
-		} else if ((p_data_header->timestamp >
-			    (tmp_data.timestamp + (sampling_interval / 2))) ||
-			   ((data_index + DATA_HEADER_SIZE + data_len) >
-			    sizeof(tmp_data.data))) {
-			push_data(&tmp_data, data_index);
-			data_index = 0;
-			tmp_data.timestamp = p_data_header->timestamp;
-		}
-		/* Complete data header */
-		tmp_data.data[data_index] = type;
-		tmp_data.data[data_index + 1] = data_len;
-		/* Copy sensor data */
-		memcpy(&tmp_data.data[data_index + DATA_HEADER_SIZE],
-		       p_data_header->data,
-		       data_len);
-		/* Increment data_index*/
-		data_index += data_len + DATA_HEADER_SIZE;
+	pool.staged[(pool.staged_head + pool.nb_staged) %
+		    RAWDATA_POOL_RECORDS] = data_to_save;
+	pool.nb_staged++;
+	RAWDATA_TRACE(RECORD_STAGED, pool.nb_staged);
+	push_staged();
+}
+
+/* Store the uptime and RTC time before the next records */
+static void push_time_anchor(void)
+{
+	struct stored_data record;
+	struct rawdata_time_anchor time_anchor;
+
+	/* Same clock as the record timestamps, both cores count the uptime
+	 * in ms from the always-on counter */
+	time_anchor.uptime = get_uptime_ms();
+	time_anchor.rtc_time = time();
+
+	record.timestamp = (uint32_t)time_anchor.uptime;
+	record.data[0] = RAWDATA_TIME_ANCHOR_TYPE;
+	record.data[1] = sizeof(time_anchor);
+	memcpy(&record.data[RAWDATA_RECORD_TLV_HEADER], &time_anchor,
+	       sizeof(time_anchor));
+	push_data((uint8_t *)&record, offsetof(struct stored_data, data) +
+		  RAWDATA_RECORD_TLV_HEADER + sizeof(time_anchor));
+
+	anchor.needed = false;
+	anchor.last_time = record.timestamp;
+}
+
+/* handle for a batch of records */
+static void handle_collector_batch(struct cfw_message *msg)
+{
+	struct rawdata_collector_batch_evt *p_evt =
+		(struct rawdata_collector_batch_evt *)msg;
+	uint16_t offset = 0;
+	uint8_t datasize;
+	uint8_t i;
+
+	RAWDATA_TRACE(BATCH_IN, p_evt->nb_records);
+	if (!storage) {
+		telemetry.stats.dropped_reports += p_evt->nb_reports;
+		return;
 	}
+
+	if (anchor.needed ||
+	    get_uptime_ms() - anchor.last_time >= TIME_ANCHOR_PERIOD)
+		push_time_anchor();
+
+	for (i = 0; i < p_evt->nb_records && offset < p_evt->length; i++) {
+		datasize = p_evt->records[offset];
+		if ((datasize < offsetof(struct stored_data, data)) ||
+		    (datasize > RAW_STORAGE_ELT_SIZE) ||
+		    (offset + sizeof(datasize) + datasize > p_evt->length))
+			break;
+		push_data(&p_evt->records[offset + sizeof(datasize)],
+			  datasize);
+		telemetry.sampled_bytes += datasize;
+		offset += sizeof(datasize) + datasize;
+	}
+	/* Time anchors are not samples */
+	if (offset)
+		boot_timeline_mark(BOOT_STEP_FIRST_SAMPLE);
+	update_throttle();
+	update_telemetry();
+}
+
+static bool start_params(const struct rawdata_session_params *params,
+			 bool resume);
+
+/* Keep the current session parameters, if they changed */
+static void save_session(bool running)
+{
+	struct saved_session session;
+
+	/* Compared as a whole, padding included */
+	memset(&session, 0, sizeof(session));
+	session.running = running;
+	session.transport = transport;
+	session.mode = sensor_parameter.mode;
+	session.sensor_mask = sensor_parameter.sensor_mask;
+	session.frequency = sensor_parameter.frequency;
+	session.feature_window = sensor_parameter.feature_window;
+	session.burst_period = sensor_parameter.burst_period;
+	session.max_latency = sensor_parameter.max_latency;
+	memcpy(session.rates, sensor_parameter.rates, sizeof(session.rates));
+	/* Saved once the previous session is read */
+	if (!saved.read ||
+	    (saved.stored && !memcmp(&session, &saved.session,
+				     sizeof(session))))
+		return;
+
+	saved.session = session;
+	if (saved.stored)
+		properties_service_write(properties_service_conn,
+					 PROJECT_PROPERTIES_SERVICE_ID,
+					 PROJECT_PROPERTY_RAWDATA_SESSION,
+					 &saved.session, sizeof(saved.session),
+					 NULL);
+	else
+		properties_service_add(properties_service_conn,
+				       PROJECT_PROPERTIES_SERVICE_ID,
+				       PROJECT_PROPERTY_RAWDATA_SESSION, false,
+				       &saved.session, sizeof(saved.session),
+				       NULL);
+	saved.stored = true;
 }
 
-/* handle for sensors data */
-static void handle_sensor_subscribe_data(struct cfw_message *msg)
+static void try_resume(void)
 {
-	sensor_service_subscribe_data_event_t *p_evt =
-		(sensor_service_subscribe_data_event_t *)msg;
+	struct rawdata_session_params params = {
+		.sensor_mask = saved.session.sensor_mask,
+		.frequency = saved.session.frequency,
+		.transport = saved.session.transport,
+		.mode = saved.session.mode,
+		.feature_window = saved.session.feature_window,
+		.burst_period = saved.session.burst_period,
+		.rates = saved.session.rates,
+		.max_latency = saved.session.max_latency,
+	};
+	uint8_t i = 0;
+	uint32_t tmp_mask = params.sensor_mask;
 
-	aggregate_and_dump(p_evt);
+	if (!saved.resume_pending || !storage || !collector_conn)
+		return;
+	while (tmp_mask) {
+		if ((tmp_mask & 1) && !sensor_registry_get_handle(i))
+			return;
+		i++;
+		tmp_mask = params.sensor_mask >> i;
+	}
+
+	saved.resume_pending = false;
+	start_params(&params, true);
 }
 
-static void handle_start_scanning_evt(struct cfw_message *msg)
+static void handle_saved_session(struct cfw_message *msg)
 {
-	sensor_service_scan_event_t *p_evt = (sensor_service_scan_event_t *)msg;
-	sensor_service_on_board_scan_data_t on_board_data =
-		p_evt->on_board_data;
-	uint8_t sensor_type = p_evt->sensor_type;
+	properties_service_read_rsp_msg_t *p_rsp =
+		(properties_service_read_rsp_msg_t *)msg;
 
-	handles[sensor_type] = GET_SENSOR_HANDLE(sensor_type,
-						 on_board_data.ch_id);
+	saved.read = true;
+	if (p_rsp->rsp_header.status == DRV_RC_OK &&
+	    p_rsp->property_size == sizeof(saved.session)) {
+		memcpy(&saved.session, &p_rsp->start_of_values,
+		       sizeof(saved.session));
+		saved.stored = true;
+		saved.resume_pending = saved.session.running &&
+				       saved.session.transport ==
+				       RAWDATA_TRANSPORT_NONE &&
+				       !session_running;
+	}
+	if (session_running) {
+		/* Started before the read */
+		save_session(true);
+	} else if (saved.resume_pending) {
+		/* Only the sensors of the session are waited for */
+		sensor_registry_scan(saved.session.sensor_mask);
+		try_resume();
+	}
 }
 
-static void handle_msg(struct cfw_message *msg, void *data)
+static void handle_sensor_found(uint8_t sensor_type, sensor_service_t handle)
+{
+	try_resume();
+}
+
+/* Only the sensors found are reported, the sessions subscribe through the raw
+ * data collector */
+static const struct sensor_registry_consumer rawdata_consumer = {
+	.sensor_mask = DEFAULT_MASK,
+	.scan_cb = handle_sensor_found,
+};
+
+/* All the reports of the session are collected */
+static void end_of_collection(void)
+{
+	/* Store the records held for the next burst */
+	burst.enabled = false;
+	if (burst.armed) {
+		burst.armed = false;
+		timer_stop(burst_timer, NULL);
+	}
+	push_staged();
+	/* The collector sends its last records before the unsubscribe
+	 * responses */
+	if (!use_stream)
+		return;
+	/* The data is kept in the storage if the transport is closed */
+	if (transport_opened(transport))
+		start_drain();
+	else
+		restore_default_conn();
+}
+
+static void dispatch_msg(struct cfw_message *msg)
 {
 	switch (CFW_MESSAGE_ID(msg)) {
-	case MSG_ID_SENSOR_SERVICE_SUBSCRIBE_DATA_RSP:;
-		uint8_t status =
-			((sensor_service_message_general_rsp_t *)msg)->status;
+	case MSG_ID_RAWDATA_COLLECTOR_SUBSCRIBE_RSP:;
+		int status = ((struct rawdata_collector_rsp *)msg)->status;
 		uint8_t response = TOPIC_STATUS_OK;
 		nb_subscribe_rsp++;
-		if (status != RESP_SUCCESS) {
+		if (status) {
 			response = TOPIC_STATUS_FAIL;
 			/* If a susbscribe failed do not wait for any more responses */
 			nb_subscribe_rsp = nb_subscribe_expected;
 		}
 
 		if (nb_subscribe_rsp == nb_subscribe_expected) {
-			raw_sensor_streaming_iq_send_itm_response(response);
+			send_response(response);
 			/* To make sure we don't send any more responses */
 			nb_subscribe_rsp++;
 		}
 		break;
-	case MSG_ID_SENSOR_SERVICE_START_SCANNING_EVT:
-		handle_start_scanning_evt(msg);
+	case MSG_ID_RAWDATA_COLLECTOR_UNSUBSCRIBE_RSP:
+		if (nb_unsubscribe_pending && !--nb_unsubscribe_pending)
+			end_of_collection();
 		break;
-	case MSG_ID_SENSOR_SERVICE_SUBSCRIBE_DATA_EVT:
-		/* Treat the data even if session is in progress */
-		if (session_running)
-			handle_sensor_subscribe_data(msg);
+	case MSG_ID_RAWDATA_COLLECTOR_BATCH_EVT:
+		/* Treat the data even if session is in progress, the last
+		 * batch comes with the unsubscribe response */
+		if (session_running || nb_unsubscribe_pending)
+			handle_collector_batch(msg);
 		break;
-	case MSG_ID_CIRCULAR_STORAGE_SERVICE_PUSH_RSP:
-		bfree(CFW_MESSAGE_PRIV(msg));
-		if (((circular_storage_service_push_rsp_msg_t *)msg)->status !=
-		    DRV_RC_OK)
-			pr_error(LOG_MODULE_MAIN, "Raw data write failure [%d]",
-				 ((circular_storage_service_push_rsp_msg_t *)
-				  msg)->status);
-		/* Peek the data even if session is in progress */
-		else if (buffer_empty && session_running && use_stream) {
-			buffer_empty = false;
-			circular_storage_service_peek(
-				circular_storage_service_conn,
-				storage,
-				NULL);
+	case MSG_ID_CIRCULAR_STORAGE_SERVICE_PUSH_RSP:;
+		struct stored_data *pushed = CFW_MESSAGE_PRIV(msg);
+		int push_status =
+			((circular_storage_service_push_rsp_msg_t *)msg)->status;
+
+		nb_pending_push--;
+		RAWDATA_TRACE(PUSH_ACKED, push_status);
+		if (push_status == DRV_RC_OK)
+			telemetry.stored_bytes += pushed->datasize;
+		if (is_pool_record(pushed)) {
+			pool_free(pushed);
+			push_staged();
+			update_throttle();
 		}
+		if (push_status != DRV_RC_OK) {
+			telemetry.stats.dropped_records++;
+			BINLOG(RAWDATA_WRITE_FAILURE, push_status);
+			check_end_of_drain();
+			break;
+		}
+		nb_stored_records++;
+		check_stream_hold();
+		/* Peek the data even if session is in progress, or if the last
+		 * records of a stopped session are being drained */
+		if (buffer_empty && (session_running || drain.running))
+			peek_more();
 		break;
 	case MSG_ID_CIRCULAR_STORAGE_SERVICE_GET_RSP:;
 		circular_storage_service_get_rsp_msg_t *init_resp =
 			(circular_storage_service_get_rsp_msg_t *)msg;
-		if (init_resp->status == DRV_RC_OK)
+		if (init_resp->status == DRV_RC_OK) {
 			storage = init_resp->storage;
-		else
+			boot_timeline_mark(BOOT_STEP_RAWDATA_STORAGE);
+			try_resume();
+		} else
 			pr_error(LOG_MODULE_MAIN,
 				 "Circular storage get failure [%d]",
 				 init_resp->status);
 		break;
+	case MSG_ID_PROP_SERVICE_READ_RSP:
+		handle_saved_session(msg);
+		break;
 	case MSG_ID_CIRCULAR_STORAGE_SERVICE_CLEAR_RSP:
-		if (CFW_MESSAGE_PRIV(msg)) {
+		if (CFW_MESSAGE_PRIV(msg) == &ack) {
+			/* Acknowledged or sent records cleared */
+			ack.nb_clear_pending--;
+			peek_more();
+		} else if (CFW_MESSAGE_PRIV(msg)) {
 			void (*start_sensors)(struct
 					      sensor_subscribe_parameters) =
 				CFW_MESSAGE_PRIV(msg);
@@ -304,39 +1253,7 @@ static void handle_msg(struct cfw_message *msg, void *data)
 	case MSG_ID_CIRCULAR_STORAGE_SERVICE_PEEK_RSP:;
 		circular_storage_service_peek_rsp_msg_t *peek_resp =
 			(circular_storage_service_peek_rsp_msg_t *)msg;
-		if (peek_resp->status == DRV_RC_OK) {
-			struct stored_data *p_data = (void *)peek_resp->buffer;
-			int rv;
-
-			buffer_empty = false;
-			rv = iasp_write(NULL, IASP_RAWDATA_CHANNEL,
-					p_data,
-					p_data->datasize, NULL, 0);
-			if (rv >= 0) {
-				circular_storage_service_clear(
-					circular_storage_service_conn,
-					storage, 1, NULL);
-
-				/* Increase the number of BLE request */
-				nb_pending_raw_data++;
-			} else {
-				pr_error(LOG_MODULE_MAIN,
-					 "iasp_write failure [%d]", rv);
-			}
-			if ((nb_pending_raw_data < RAWDATA_IASP_MAX_MSGS) &&
-			    con_opened) {
-				/* try to push more data */
-				circular_storage_service_peek(
-					circular_storage_service_conn,
-					storage,
-					NULL);
-			}
-		} else {
-			buffer_empty = true;
-			/* Check end of session */
-			check_end_of_session();
-		}
-
+		handle_peek(peek_resp->status, (void *)peek_resp->buffer);
 		bfree(peek_resp->buffer);
 		break;
 	default: break;
@@ -344,21 +1261,94 @@ static void handle_msg(struct cfw_message *msg, void *data)
 	cfw_msg_free(msg);
 }
 
+static void handle_msg(struct cfw_message *msg, void *data)
+{
+	switch (CFW_MESSAGE_ID(msg)) {
+	/* The storage completions keep the transport busy */
+	case MSG_ID_CIRCULAR_STORAGE_SERVICE_PUSH_RSP:
+	case MSG_ID_CIRCULAR_STORAGE_SERVICE_PEEK_RSP:
+		msg_lanes_post(MSG_LANE_PRIORITY, msg, dispatch_msg);
+		break;
+	/* The batches, and the responses that must come after them */
+	default:
+		msg_lanes_post(MSG_LANE_BULK, msg, dispatch_msg);
+		break;
+	}
+}
+
+/* Reporting interval letting the sensor core read the hardware FIFO in bursts */
+static uint16_t fifo_reporting_interval(uint16_t sampling_interval)
+{
+	return MIN((uint32_t)FIFO_MAX_SAMPLES * sampling_interval, UINT16_MAX);
+}
+
+/* Subscribe to a sensor with its own rate and latency */
+static void subscribe_sensor(const struct sensor_subscribe_parameters *
+			     parameters, uint8_t type)
+{
+	const struct rawdata_sensor_rate *rate = &parameters->rates[type];
+	uint16_t frequency = rate->frequency ? rate->frequency :
+			     parameters->frequency;
+	uint16_t latency = rate->latency ? rate->latency :
+			   parameters->max_latency ? parameters->max_latency :
+			   MAXIMUM_LATENCY;
+	/* Sampling interval = 1000 (ms) / frequency */
+	uint16_t sampling_interval = 1000 / frequency;
+	/* Reporting interval is the minimum between:
+	 * - Maximum expected latency
+	 * - and time to have 5 samples (5 * sampling_interval)
+	 * In FIFO mode, it is the time to have FIFO_MAX_SAMPLES samples */
+	uint16_t reporting_interval = MIN(sampling_interval * 5, latency);
+	uint16_t batch_interval = latency;
+	uint16_t feature_window = 0;
+
+	if (parameters->max_latency) {
+		/* Latency budget: a quarter for the sensor core reports, a
+		 * quarter for the batches, the rest for the storage and the
+		 * streaming bursts */
+		reporting_interval = MAX(sampling_interval,
+					 MIN(latency / 4,
+					     fifo_reporting_interval(
+						     sampling_interval)));
+		batch_interval = latency / 4;
+	}
+
+	if (parameters->mode == RAWDATA_MODE_FIFO) {
+		reporting_interval = fifo_reporting_interval(sampling_interval);
+		/* The budget may be shorter than the FIFO watermark */
+		if (parameters->max_latency)
+			reporting_interval = MIN(reporting_interval,
+						 batch_interval);
+		/* Forward the records of a burst together */
+		batch_interval = reporting_interval;
+	} else if (parameters->mode == RAWDATA_MODE_BURST) {
+		/* The sensor core only sends full batches, or the records of
+		 * the burst period */
+		reporting_interval = fifo_reporting_interval(sampling_interval);
+		batch_interval = parameters->burst_period;
+	} else if (parameters->mode == RAWDATA_MODE_FEATURES) {
+		/* Latency does not matter, read the FIFO in bursts but report
+		 * at least once per window */
+		feature_window = parameters->feature_window;
+		reporting_interval = MIN(fifo_reporting_interval(
+						 sampling_interval),
+					 feature_window);
+		batch_interval = feature_window;
+	}
+
+	rawdata_collector_subscribe(collector_conn, NULL,
+				    sensor_registry_get_handle(type),
+				    frequency, reporting_interval,
+				    batch_interval, feature_window);
+	BINLOG(RAWDATA_SUBSCRIBE, type, frequency, reporting_interval);
+}
 
 /* Start session subscribing to expected sensors */
 static void start_session(struct sensor_subscribe_parameters parameters)
 {
-	uint8_t data_type = ACCEL_DATA;
 	uint8_t i = 0;
 	uint32_t tmp_mask = parameters.sensor_mask;
 
-	/* Sampling interval = 1000 (ms) / frequency */
-	sampling_interval = 1000 / parameters.frequency;
-	/* Reporting interval is the minimum between:
-	 * - Maximum expected latency
-	 * - and time to have 5 samples (5 * sampling_interval) */
-	uint8_t reporting_interval = MIN(sampling_interval * 5, MAXIMUM_LATENCY);
-
 	pr_debug(LOG_MODULE_MAIN,
 		 "START RAW DATA SESSION - sensor_mask: %d, freq: %d",
 		 parameters.sensor_mask,
@@ -367,13 +1357,8 @@ static void start_session(struct sensor_subscribe_parameters parameters)
 	nb_subscribe_expected = 0;
 	nb_subscribe_rsp = 0;
 	while (tmp_mask) {
-		if ((tmp_mask & 1) && handles[i]) {
-			sensor_service_subscribe_data(sensor_service_conn, NULL,
-						      handles[i],
-						      &data_type, 1,
-						      parameters.frequency,
-						      reporting_interval);
-			pr_debug(LOG_MODULE_MAIN, "Sub %d", i);
+		if ((tmp_mask & 1) && sensor_registry_get_handle(i)) {
+			subscribe_sensor(&parameters, i);
 			nb_subscribe_expected++;
 		}
 		i++;
@@ -381,96 +1366,243 @@ static void start_session(struct sensor_subscribe_parameters parameters)
 	}
 
 	session_running = true;
-	/* When starting the session the buffer is empty */
-	buffer_empty = true;
+	RAWDATA_TRACE(SESSION_START, parameters.sensor_mask);
+	anchor.needed = true;
+	burst.enabled = parameters.mode == RAWDATA_MODE_BURST;
+	burst.running = false;
+	burst.period = parameters.burst_period;
+	burst.last_time = get_uptime_ms();
+	/* The sensor core resets its throttle once no sensor is subscribed */
+	pool.throttle = 0;
+	/* When starting the session the buffer is empty, unless the previous
+	 * session is still draining */
+	if (!drain.running)
+		buffer_empty = true;
 }
 
 
-/* Check expected sensors can be used */
-bool rawdata_start(uint32_t sensor_mask, uint32_t frequency, bool use_streaming)
+/* Check expected sensors can be used. A resumed session keeps the records
+ * already stored */
+static bool start_params(const struct rawdata_session_params *params,
+			 bool resume)
 {
+	bool use_streaming = params->transport != RAWDATA_TRANSPORT_NONE;
+
 	/* Clear circular storage only if:
 	 * sensors and circular storage are successfully initialized and
 	 * session is not running and
-	 * BLE connection is open if streaming is used */
-	if (!session_running && storage && (con_opened || !use_streaming)) {
-		/* Store the subscribe parameters */
-		sensor_parameter.sensor_mask = sensor_mask;
-		sensor_parameter.frequency = frequency;
-
+	 * no previous session is draining, unless streaming is used */
+	if (!session_running && !nb_unsubscribe_pending &&
+	    !ack.nb_clear_pending &&
+	    storage &&
+	    collector_conn && (!drain.running || (use_streaming &&
+				params->transport == transport))) {
 		uint8_t i = 0;
-		uint32_t tmp_mask = sensor_mask;
+		uint32_t tmp_mask = params->sensor_mask;
+		uint16_t max_period;
+
 		while (tmp_mask) {
-			if ((tmp_mask & 1) && !handles[i]) {
+			if ((tmp_mask & 1) && !sensor_registry_get_handle(i)) {
 				pr_error(LOG_MODULE_MAIN, "Invalid sensor %d",
 					 i);
-				raw_sensor_streaming_iq_send_itm_response(
-					TOPIC_STATUS_FAIL);
+				/* Found by the next attempt if it exists */
+				sensor_registry_scan(params->sensor_mask);
+				send_response(TOPIC_STATUS_FAIL);
 				return false;
 			}
 			i++;
-			tmp_mask = sensor_mask >> i;
+			tmp_mask = params->sensor_mask >> i;
+		}
+
+		/* The records of a burst period must fit in the RAM */
+		max_period = burst_max_period(params);
+		if (params->mode == RAWDATA_MODE_BURST &&
+		    params->burst_period > max_period) {
+			pr_error(LOG_MODULE_MAIN, "Burst period above %d ms",
+				 max_period);
+			send_response(TOPIC_STATUS_FAIL);
+			return false;
+		}
+		if (params->mode == RAWDATA_MODE_FEATURES &&
+		    !feature_window_fits(params, params->feature_window ?
+					 params->feature_window :
+					 RAWDATA_DEFAULT_FEATURE_WINDOW)) {
+			pr_error(LOG_MODULE_MAIN,
+				 "Feature window above %d samples", UINT16_MAX);
+			send_response(TOPIC_STATUS_FAIL);
+			return false;
+		}
+
+		/* The transport must be open if streaming is used */
+		if (use_streaming && !transport_opened(params->transport)) {
+			pr_error(LOG_MODULE_MAIN, "Raw data transport closed");
+			send_response(TOPIC_STATUS_FAIL);
+			return false;
 		}
 
+		/* Store the subscribe parameters */
+		sensor_parameter.sensor_mask = params->sensor_mask;
+		sensor_parameter.frequency = params->frequency;
+		sensor_parameter.mode = params->mode;
+		sensor_parameter.max_latency = params->max_latency;
+		/* The streaming gets what is left of the latency budget */
+		hold.duration = use_streaming ? params->max_latency / 4 : 0;
+		hold.burst = false;
+		hold.start = get_uptime_ms();
+		if (params->rates)
+			memcpy(sensor_parameter.rates, params->rates,
+			       sizeof(sensor_parameter.rates));
+		else
+			memset(sensor_parameter.rates, 0,
+			       sizeof(sensor_parameter.rates));
+		sensor_parameter.feature_window = params->feature_window ?
+						  params->feature_window :
+						  RAWDATA_DEFAULT_FEATURE_WINDOW;
+		sensor_parameter.burst_period = params->burst_period ?
+						params->burst_period :
+						max_period;
+		transport = params->transport;
+		use_stream = use_streaming;
+		/* The session and its drain follow the USB port state */
+		rawdata_usb_watch(transport == RAWDATA_TRANSPORT_USB);
+
+		/* The high-water marks and drop counters cover the session */
+		memset(&telemetry.stats, 0, sizeof(telemetry.stats));
+
+		if (resume) {
+			pr_info(LOG_MODULE_MAIN, "Raw data session resumed");
+			start_session(sensor_parameter);
+			return true;
+		}
+		if (drain.running) {
+			/* Keep the previous session data, the new records are
+			 * streamed once the backlog is drained */
+			pr_info(LOG_MODULE_MAIN,
+				"New session, %d records still draining",
+				nb_stored_records);
+			start_session(sensor_parameter);
+			return true;
+		}
+		nb_stored_records = 0;
+		/* The records not acknowledged yet are cleared too */
+		ack.acked_seq = ack.tx_seq;
+		ack.cleared_seq = ack.tx_seq;
+		RAWDATA_TRACE(CLEAR_SENT, 0);
 		circular_storage_service_clear(circular_storage_service_conn,
 					       storage, 0, start_session);
-		if (use_streaming) {
+		if (transport == RAWDATA_TRANSPORT_IASP) {
 			struct bt_le_conn_param con_params = { 8, 16, 0, 100 };
 			/* Speed up the connection before starting the streaming */
 			ble_app_conn_update(&con_params);
+			requested_conn_interval = con_params.interval_max;
 		}
-		use_stream = use_streaming;
 		return true;
 	}
-	raw_sensor_streaming_iq_send_itm_response(
-		TOPIC_STATUS_FAIL);
+	send_response(TOPIC_STATUS_FAIL);
 	return false;
 }
 
+bool rawdata_start_session(const struct rawdata_session_params *params)
+{
+	if (!start_params(params, false))
+		return false;
+	/* A session started before the saved one is read is not resumed */
+	saved.resume_pending = false;
+	save_session(true);
+	return true;
+}
+
+bool rawdata_set_sensor_rate(uint8_t sensor_type, uint16_t frequency,
+			     uint16_t latency)
+{
+	if (sensor_type >= RAWDATA_MAX_SENSORS)
+		return false;
+	sensor_rates[sensor_type].frequency = frequency;
+	sensor_rates[sensor_type].latency = latency;
+	return true;
+}
+
+const struct rawdata_sensor_rate *rawdata_get_sensor_rates(void)
+{
+	return sensor_rates;
+}
+
+void rawdata_set_max_latency(uint16_t max_latency)
+{
+	default_max_latency = max_latency;
+}
+
+uint16_t rawdata_get_max_latency(void)
+{
+	return default_max_latency;
+}
+
+void rawdata_set_drop_policy(enum rawdata_drop_policy policy)
+{
+	pool.policy = policy;
+	/* A throttled rate is restored by the next pool update */
+}
+
+bool rawdata_start(uint32_t sensor_mask, uint32_t frequency, bool use_streaming)
+{
+	struct rawdata_session_params params = {
+		.sensor_mask = sensor_mask,
+		.frequency = frequency,
+		.transport = use_streaming ? RAWDATA_TRANSPORT_IASP :
+			     RAWDATA_TRANSPORT_NONE,
+		.mode = RAWDATA_MODE_SAMPLES,
+		.feature_window = 0,
+		.burst_period = 0,
+		.rates = sensor_rates,
+		.max_latency = default_max_latency,
+	};
+
+	iq_request = true;
+	return rawdata_start_session(&params);
+}
+
 /* Stop raw data sensor collection unsubscribing to sensors */
-bool rawdata_end(void)
+bool rawdata_end_session(void)
 {
-	uint8_t data_type = ACCEL_DATA;
 	uint8_t i = 0;
 	uint32_t tmp_mask = sensor_parameter.sensor_mask;
 
 	if (session_running) {
-		/* Send last saved data and reset variables */
-		if (data_index) {
-			push_data(&tmp_data, data_index);
-			/* Reset data_index value */
-			data_index = 0;
-		}
 		while (tmp_mask) {
-			if ((tmp_mask & 1) && handles[i]) {
-				pr_debug(LOG_MODULE_MAIN, "Unsub %d", i);
-				sensor_service_unsubscribe_data(
-					sensor_service_conn, NULL,
-					handles[i],
-					&data_type, 1);
+			if ((tmp_mask & 1) && sensor_registry_get_handle(i)) {
+				BINLOG(RAWDATA_UNSUBSCRIBE, i);
+				rawdata_collector_unsubscribe(
+					collector_conn, NULL,
+					sensor_registry_get_handle(i));
+				nb_unsubscribe_pending++;
 			}
 			i++;
 			tmp_mask = sensor_parameter.sensor_mask >> i;
 		}
 
 		session_running = false;
-		if (!use_stream) {
-			pr_info(LOG_MODULE_MAIN, "Raw data session is over");
-			raw_sensor_streaming_iq_send_itm_response(
-				TOPIC_STATUS_OK);
-		} else {
-			/* Check end of session */
-			check_end_of_session();
-		}
+		RAWDATA_TRACE(SESSION_END, NB_UNSTORED_RECORDS);
+		/* Do not wait for the stored data to be streamed, it keeps being
+		 * drained in the background */
+		pr_info(LOG_MODULE_MAIN, "Raw data session is over");
+		send_response(TOPIC_STATUS_OK);
+		if (!nb_unsubscribe_pending)
+			end_of_collection();
 
 		pr_debug(LOG_MODULE_MAIN, "STOPPING RAW DATA SESSION");
+		save_session(false);
 		return true;
 	}
-	raw_sensor_streaming_iq_send_itm_response(
-		TOPIC_STATUS_FAIL);
+	send_response(TOPIC_STATUS_FAIL);
 	return false;
 }
 
+bool rawdata_end(void)
+{
+	iq_request = true;
+	return rawdata_end_session();
+}
+
 
 static void service_connection_cb(cfw_service_conn_t *handle, void *param)
 {
@@ -478,21 +1610,49 @@ static void service_connection_cb(cfw_service_conn_t *handle, void *param)
 		circular_storage_service_conn = handle;
 		circular_storage_service_get(circular_storage_service_conn,
 					     RAW_STORAGE_KEY, NULL);
+	} else if ((void *)PROPERTIES_SERVICE_ID == param) {
+		properties_service_conn = handle;
+		properties_service_read(handle, PROJECT_PROPERTIES_SERVICE_ID,
+					PROJECT_PROPERTY_RAWDATA_SESSION, NULL);
 	} else {
-		/* ARC_SC_SVC_ID */
-		memset(handles, 0, ON_BOARD_SENSOR_TYPE_END + 1);
-		sensor_service_conn = handle;
-		sensor_service_start_scanning(handle, NULL, ~(0));
+		/* RAWDATA_COLLECTOR_SERVICE_ID */
+		collector_conn = handle;
+		boot_timeline_mark(BOOT_STEP_RAWDATA_COLLECTOR);
+		try_resume();
+	}
+}
+
+static void usb_tx_complete(void)
+{
+	if (transport == RAWDATA_TRANSPORT_USB)
+		handle_tx_complete();
+}
+
+static void usb_line_changed(bool opened)
+{
+	if (transport != RAWDATA_TRANSPORT_USB || !use_stream)
+		return;
+	if (!opened) {
+		pr_debug(LOG_MODULE_MAIN, "RAW DATA USB PORT CLOSED");
+		transport_closed();
+		return;
 	}
+	pr_debug(LOG_MODULE_MAIN, "RAW DATA USB PORT OPENED");
+	/* Resume the drain aborted when the port was closed */
+	if (!session_running && !drain.running && nb_stored_records)
+		start_drain();
+	else
+		peek_more();
 }
 
-void rawdata_init(T_QUEUE queue)
+void rawdata_init(T_QUEUE queue, xloop_t *loop)
 {
 	client = cfw_client_init(queue, handle_msg, NULL);
 
-	/* Open the sensor service */
-	cfw_open_service_helper(client, ARC_SC_SVC_ID,
-				service_connection_cb, (void *)ARC_SC_SVC_ID);
+	/* Open the raw data collector of the sensor core */
+	cfw_open_service_helper(client, RAWDATA_COLLECTOR_SERVICE_ID,
+				service_connection_cb,
+				(void *)RAWDATA_COLLECTOR_SERVICE_ID);
 
 	/* Open the circular_storage service */
 	cfw_open_service_helper(client,
@@ -500,8 +1660,27 @@ void rawdata_init(T_QUEUE queue)
 				service_connection_cb,
 				(void *)CIRCULAR_STORAGE_SERVICE_ID);
 
-	/* Register IASP channel */
+	/* Open the properties service, for the last session */
+	cfw_open_service_helper(client,
+				PROPERTIES_SERVICE_ID,
+				service_connection_cb,
+				(void *)PROPERTIES_SERVICE_ID);
+
+	/* Scan the sensors of the default session */
+	sensor_registry_register(SENSOR_REGISTRY_RAWDATA, &rawdata_consumer);
+
+	/* Register IASP channels */
 	iasp_register(&raw_data_iasp);
+	iasp_register(&raw_data_status_iasp);
+
+	/* Bind the USB transport */
+	rawdata_usb_init(loop, usb_tx_complete, usb_line_changed);
+
+	/* End of the streaming holds */
+	main_loop = loop;
+	hold_timer = timer_create(hold_timer_cb, NULL, 1, false, false, NULL);
+	/* End of the burst periods */
+	burst_timer = timer_create(burst_timer_cb, NULL, 1, false, false, NULL);
 
 	/* Set callback for IQ */
 	raw_sensor_streaming_iq_set_start_session_cb(rawdata_start);
@@ -34,26 +34,201 @@
 
 #include "os/os.h"
 #include "util/misc.h"
+#include "infra/xloop.h"
 /* Main sensors API */
 #include "services/sensor_service/sensor_service.h"
 
+#include "rawdata_record.h"
+
 #define RAW_STORAGE_KEY      GEN_KEY('S', 'R', 'A', 'W')
 /* Max size of the stored element */
-#define RAW_STORAGE_ELT_SIZE 128
+#define RAW_STORAGE_ELT_SIZE RAWDATA_RECORD_SIZE
 
 #define DEFAULT_MASK         ACCEL_TYPE_MASK | GYRO_TYPE_MASK
 #define DEFAULT_FREQ         100
 
+/* Transport used to stream the raw data */
+enum rawdata_transport {
+	/* Data is only stored */
+	RAWDATA_TRANSPORT_NONE,
+	/* Data is streamed over BLE on the raw data IASP channel */
+	RAWDATA_TRANSPORT_IASP,
+	/* Data is streamed on the raw data USB CDC-ACM port */
+	RAWDATA_TRANSPORT_USB,
+};
+
+/* How the sensor core reads the sensors */
+enum rawdata_mode {
+	/* Samples are reported within the maximum expected latency */
+	RAWDATA_MODE_SAMPLES,
+	/* Samples are read from the hardware FIFO in bursts: the sensor core
+	 * sleeps between bursts, at the cost of a higher latency */
+	RAWDATA_MODE_FIFO,
+	/* Only the features of the accel and gyro samples over a window are
+	 * stored, see struct rawdata_features */
+	RAWDATA_MODE_FEATURES,
+	/* Samples are read from the hardware FIFO and held in RAM, in full
+	 * batches on the sensor core and in the raw data pool, then written to
+	 * the storage in one burst at most once per burst period: the Quark and
+	 * the flash sleep in between. For long sessions without streaming */
+	RAWDATA_MODE_BURST,
+};
+
+/* Default window of the features mode in ms */
+#define RAWDATA_DEFAULT_FEATURE_WINDOW  1000
+
+/* What happens to a record when the raw data pool is full */
+enum rawdata_drop_policy {
+	/* The new record is dropped */
+	RAWDATA_DROP_NEWEST,
+	/* The oldest record waiting for the storage is dropped */
+	RAWDATA_DROP_OLDEST,
+	/* The sensor core halves the sampling rate while the pool is filling,
+	 * down to 1/8, and restores it once the pool is drained. The new
+	 * record is dropped if the pool is still full */
+	RAWDATA_DROP_THROTTLE,
+};
+
+/* Size of the per sensor tables, indexed by sensor type */
+#define RAWDATA_MAX_SENSORS  (ON_BOARD_SENSOR_TYPE_END + 1)
+
+/* Rate and latency of a sensor, 0 to use the session default */
+struct rawdata_sensor_rate {
+	/* Sampling rate frequency in Hz */
+	uint16_t frequency;
+	/* Maximum latency of the reports in ms */
+	uint16_t latency;
+};
+
+/* Raw data session parameters */
+struct rawdata_session_params {
+	/* List of sensors to activate */
+	uint32_t sensor_mask;
+	/* Sampling rate frequency */
+	uint32_t frequency;
+	enum rawdata_transport transport;
+	enum rawdata_mode mode;
+	/* Window of the features mode in ms, holding at most UINT16_MAX samples
+	 * of each sensor */
+	uint16_t feature_window;
+	/* Maximum time between two storage bursts of the burst mode in ms, at
+	 * most the time the RAM holds the samples of the session. 0 for that
+	 * longest period */
+	uint16_t burst_period;
+	/* Per sensor rate and latency, RAWDATA_MAX_SENSORS entries indexed by
+	 * sensor type. If NULL, all the sensors use frequency */
+	const struct rawdata_sensor_rate *rates;
+	/* Maximum latency in ms from a sample to the storage and to the phone.
+	 * The larger it is, the more the reports, batches and streamed records
+	 * are grouped. 0 keeps the default 100 ms reporting latency and streams
+	 * the records as soon as they are stored */
+	uint16_t max_latency;
+};
+
+/* Raw data streaming telemetry */
+struct rawdata_stats {
+	/* Sensor data received from the sensor core, in bytes/s */
+	uint32_t sampled_rate;
+	/* Records written in the storage, in bytes/s */
+	uint32_t stored_rate;
+	/* Records sent on the transport, in bytes/s */
+	uint32_t streamed_rate;
+	/* Records stored and not streamed yet */
+	uint32_t backlog;
+	/* Sensor reports lost because the storage is not available */
+	uint32_t dropped_reports;
+	/* Records lost on a storage write failure */
+	uint32_t dropped_records;
+	/* High-water mark of the records pushed to the storage */
+	uint8_t pending_push_max;
+	/* High-water mark of the records pending on the transport */
+	uint8_t pending_tx_max;
+	/* High-water mark of the records not acknowledged by the host */
+	uint8_t unacked_max;
+	/* Requested BLE connection interval in 1.25 ms units, 0 if default */
+	uint16_t requested_conn_interval;
+	/* Records dropped because the raw data pool is full */
+	uint32_t pool_dropped_newest;
+	uint32_t pool_dropped_oldest;
+	/* High-water mark of the raw data pool records in use */
+	uint8_t pool_used_max;
+	/* Current sampling rate division of the throttle policy, as a shift */
+	uint8_t throttle;
+	/* Storage bursts of the burst mode */
+	uint32_t bursts;
+};
+
 /** Raw Data sensor Collection init.
  * This will start the required services and start sensor scanning.
  *
  * @param queue message queue to be used
+ * @param loop main loop of the queue
  */
-void rawdata_init(T_QUEUE queue);
+void rawdata_init(T_QUEUE queue, xloop_t *loop);
 
 /** Raw Data sensor Collection start.
  * This will subscribe to accel and gyro events.
  *
+ * @param params session parameters
+ * @return true if sensors are started, false otherwise
+ */
+bool rawdata_start_session(const struct rawdata_session_params *params);
+
+/** Raw Data sensor Collection end.
+ * This will unsubscribe to accel and gyro events, see rawdata_end.
+ * @return true if sensors are stopped, false otherwise
+ */
+bool rawdata_end_session(void);
+
+/** Get the raw data streaming telemetry.
+ * The rates are averaged over the last second with activity, the high-water
+ * marks cover the current session.
+ *
+ * @param stats filled with the current telemetry
+ */
+void rawdata_get_stats(struct rawdata_stats *stats);
+
+/** Set the rate and latency of a sensor for the next sessions.
+ * The raw sensor streaming IQ only carries one frequency, the sessions it
+ * starts use this table.
+ *
+ * @param sensor_type sensor type
+ * @param frequency sampling rate frequency in Hz, 0 for the session frequency
+ * @param latency maximum latency in ms, 0 for the default latency
+ * @return true on success, false if the sensor type is invalid
+ */
+bool rawdata_set_sensor_rate(uint8_t sensor_type, uint16_t frequency,
+			     uint16_t latency);
+
+/** Get the table set by rawdata_set_sensor_rate.
+ *
+ * @return RAWDATA_MAX_SENSORS entries indexed by sensor type
+ */
+const struct rawdata_sensor_rate *rawdata_get_sensor_rates(void);
+
+/** Set the maximum latency of the next sessions started by the IQ or the TCMD.
+ *
+ * @param max_latency maximum latency in ms, 0 for the default behaviour
+ */
+void rawdata_set_max_latency(uint16_t max_latency);
+
+/** Get the maximum latency set by rawdata_set_max_latency.
+ *
+ * @return maximum latency in ms
+ */
+uint16_t rawdata_get_max_latency(void);
+
+/** Set the policy applied when the raw data pool is full.
+ * The records are staged in a pool reserved to the raw data, so that the
+ * streaming load never takes memory from the rest of the system.
+ *
+ * @param policy drop policy
+ */
+void rawdata_set_drop_policy(enum rawdata_drop_policy policy);
+
+/** Raw Data sensor Collection start on request of the raw sensor streaming IQ.
+ * The result is sent back to the IQ.
+ *
  * @param sensor_mask list of sensors to activate
  * @param frequency sampling rate frequency
  * @param use_streaming true if streaming is used, false otherwise
@@ -61,8 +236,12 @@ void rawdata_init(T_QUEUE queue);
  */
 bool rawdata_start(uint32_t sensor_mask, uint32_t frequency, bool use_streaming);
 
-/** Raw Data sensor Collection end.
+/** Raw Data sensor Collection end on request of the raw sensor streaming IQ.
  * This will unsubscribe to accel and gyro events.
+ * The stop request is acknowledged right away; in streaming mode the stored
+ * data keeps being streamed in the background and the drain progress is
+ * reported on the raw data status channel. A new session can be started
+ * while the previous one is still draining.
  * @return true if sensors are stopped, false otherwise
  */
 bool rawdata_end(void);
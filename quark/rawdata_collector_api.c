@@ -0,0 +1,88 @@
+/*
+ * Copyright (c) 2016, Intel Corporation. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ * this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ * this list of conditions and the following disclaimer in the documentation
+ * and/or other materials provided with the distribution.
+ *
+ * 3. Neither the name of the copyright holder nor the names of its contributors
+ * may be used to endorse or promote products derived from this software without
+ * specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include "cfw/cfw.h"
+
+#include "rawdata_collector.h"
+
+int rawdata_collector_subscribe(cfw_service_conn_t *conn, void *priv,
+				sensor_service_t handle, uint16_t frequency,
+				uint16_t reporting_interval,
+				uint16_t batch_interval,
+				uint16_t feature_window)
+{
+	struct rawdata_collector_subscribe_req *req =
+		(struct rawdata_collector_subscribe_req *)
+		cfw_alloc_message_for_service(
+			conn, MSG_ID_RAWDATA_COLLECTOR_SUBSCRIBE_REQ,
+			sizeof(*req), priv);
+
+	if (!req)
+		return -1;
+
+	req->handle = handle;
+	req->frequency = frequency;
+	req->reporting_interval = reporting_interval;
+	req->batch_interval = batch_interval;
+	req->feature_window = feature_window;
+	return cfw_send_message(req);
+}
+
+int rawdata_collector_unsubscribe(cfw_service_conn_t *conn, void *priv,
+				  sensor_service_t handle)
+{
+	struct rawdata_collector_unsubscribe_req *req =
+		(struct rawdata_collector_unsubscribe_req *)
+		cfw_alloc_message_for_service(
+			conn, MSG_ID_RAWDATA_COLLECTOR_UNSUBSCRIBE_REQ,
+			sizeof(*req), priv);
+
+	if (!req)
+		return -1;
+
+	req->handle = handle;
+	return cfw_send_message(req);
+}
+
+int rawdata_collector_throttle(cfw_service_conn_t *conn, void *priv,
+			       uint8_t shift)
+{
+	struct rawdata_collector_throttle_req *req =
+		(struct rawdata_collector_throttle_req *)
+		cfw_alloc_message_for_service(
+			conn, MSG_ID_RAWDATA_COLLECTOR_THROTTLE_REQ,
+			sizeof(*req), priv);
+
+	if (!req)
+		return -1;
+
+	req->shift = shift;
+	return cfw_send_message(req);
+}
@@ -0,0 +1,302 @@
+/*
+ * Copyright (c) 2016, Intel Corporation. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ * this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ * this list of conditions and the following disclaimer in the documentation
+ * and/or other materials provided with the distribution.
+ *
+ * 3. Neither the name of the copyright holder nor the names of its contributors
+ * may be used to endorse or promote products derived from this software without
+ * specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "infra/tcmd/handler.h"
+
+#include "rawdata.h"
+#include "rawdata_trace.h"
+
+static const char *const transport_names[] = {
+	[RAWDATA_TRANSPORT_NONE] = "none",
+	[RAWDATA_TRANSPORT_IASP] = "iasp",
+	[RAWDATA_TRANSPORT_USB] = "usb",
+};
+
+/*
+ * Start a raw data session:
+ * rawdata start <sensor_mask> <frequency> <transport>
+ *               [fifo|features [window]|burst [period]]
+ * transport is one of none, iasp or usb, fifo reads the sensors hardware FIFO
+ * in bursts, features only keeps the features of the samples over windows of
+ * the given duration in ms, burst holds the records in RAM and writes them to
+ * the storage in bursts at most the given period apart in ms. The period is
+ * at most, and by default, the time the RAM holds the samples of the session.
+ *
+ * @param[in]   argc        Number of arguments in the Test Command (including group and name)
+ * @param[in]   argv        Table of null-terminated buffers containing the arguments
+ * @param[in]   ctx         The context to pass back to responses
+ */
+void rawdata_tcmd_start(int argc, char *argv[], struct tcmd_handler_ctx *ctx)
+{
+	struct rawdata_session_params params;
+	uint8_t i;
+
+	if (argc < 5 || argc > 7)
+		goto print_help;
+
+	params.sensor_mask = strtoul(argv[2], NULL, 0);
+	params.frequency = strtoul(argv[3], NULL, 0);
+	if (!params.sensor_mask || !params.frequency)
+		goto print_help;
+
+	for (i = 0; i < ARRAY_SIZE(transport_names); i++)
+		if (!strcmp(argv[4], transport_names[i]))
+			break;
+	if (i == ARRAY_SIZE(transport_names))
+		goto print_help;
+	params.transport = i;
+
+	params.mode = RAWDATA_MODE_SAMPLES;
+	params.feature_window = 0;
+	params.burst_period = 0;
+	params.rates = rawdata_get_sensor_rates();
+	params.max_latency = rawdata_get_max_latency();
+	if (argc == 6 && !strcmp(argv[5], "fifo")) {
+		params.mode = RAWDATA_MODE_FIFO;
+	} else if (argc >= 6 && !strcmp(argv[5], "features")) {
+		params.mode = RAWDATA_MODE_FEATURES;
+		if (argc == 7)
+			params.feature_window = strtoul(argv[6], NULL, 0);
+	} else if (argc >= 6 && !strcmp(argv[5], "burst")) {
+		params.mode = RAWDATA_MODE_BURST;
+		if (argc == 7)
+			params.burst_period = strtoul(argv[6], NULL, 0);
+	} else if (argc != 5) {
+		goto print_help;
+	}
+
+	if (rawdata_start_session(&params))
+		TCMD_RSP_FINAL(ctx, NULL);
+	else
+		TCMD_RSP_ERROR(ctx, "Session not started");
+	return;
+
+print_help:
+	TCMD_RSP_ERROR(ctx, "Usage: rawdata start <mask> <freq> none|iasp|usb "
+		       "[fifo|features [window]|burst [period]]");
+}
+
+DECLARE_TEST_COMMAND(rawdata, start, rawdata_tcmd_start);
+
+/*
+ * Stop the raw data session: rawdata stop
+ *
+ * @param[in]   argc        Number of arguments in the Test Command (including group and name)
+ * @param[in]   argv        Table of null-terminated buffers containing the arguments
+ * @param[in]   ctx         The context to pass back to responses
+ */
+void rawdata_tcmd_stop(int argc, char *argv[], struct tcmd_handler_ctx *ctx)
+{
+	if (rawdata_end_session())
+		TCMD_RSP_FINAL(ctx, NULL);
+	else
+		TCMD_RSP_ERROR(ctx, "No session running");
+}
+
+DECLARE_TEST_COMMAND(rawdata, stop, rawdata_tcmd_stop);
+
+/*
+ * Set the rate of a sensor for the next sessions:
+ * rawdata rate <sensor_type> <frequency> <latency>
+ * 0 selects the session frequency or the default latency.
+ *
+ * @param[in]   argc        Number of arguments in the Test Command (including group and name)
+ * @param[in]   argv        Table of null-terminated buffers containing the arguments
+ * @param[in]   ctx         The context to pass back to responses
+ */
+void rawdata_tcmd_rate(int argc, char *argv[], struct tcmd_handler_ctx *ctx)
+{
+	if (argc != 5) {
+		TCMD_RSP_ERROR(ctx,
+			       "Usage: rawdata rate <sensor_type> <freq> <latency>");
+		return;
+	}
+
+	if (rawdata_set_sensor_rate(strtoul(argv[2], NULL, 0),
+				    strtoul(argv[3], NULL, 0),
+				    strtoul(argv[4], NULL, 0)))
+		TCMD_RSP_FINAL(ctx, NULL);
+	else
+		TCMD_RSP_ERROR(ctx, "Invalid sensor type");
+}
+
+DECLARE_TEST_COMMAND(rawdata, rate, rawdata_tcmd_rate);
+
+/*
+ * Set the maximum latency of the next sessions: rawdata latency <ms>
+ * 0 selects the default latency.
+ *
+ * @param[in]   argc        Number of arguments in the Test Command (including group and name)
+ * @param[in]   argv        Table of null-terminated buffers containing the arguments
+ * @param[in]   ctx         The context to pass back to responses
+ */
+void rawdata_tcmd_latency(int argc, char *argv[], struct tcmd_handler_ctx *ctx)
+{
+	if (argc != 3) {
+		TCMD_RSP_ERROR(ctx, "Usage: rawdata latency <ms>");
+		return;
+	}
+
+	rawdata_set_max_latency(strtoul(argv[2], NULL, 0));
+	TCMD_RSP_FINAL(ctx, NULL);
+}
+
+DECLARE_TEST_COMMAND(rawdata, latency, rawdata_tcmd_latency);
+
+static const char *const policy_names[] = {
+	[RAWDATA_DROP_NEWEST] = "newest",
+	[RAWDATA_DROP_OLDEST] = "oldest",
+	[RAWDATA_DROP_THROTTLE] = "throttle",
+};
+
+/*
+ * Set the policy applied when the raw data pool is full:
+ * rawdata policy newest|oldest|throttle
+ * newest drops the new records, oldest the oldest records waiting for the
+ * storage, throttle lowers the sampling rate of the sensor core.
+ *
+ * @param[in]   argc        Number of arguments in the Test Command (including group and name)
+ * @param[in]   argv        Table of null-terminated buffers containing the arguments
+ * @param[in]   ctx         The context to pass back to responses
+ */
+void rawdata_tcmd_policy(int argc, char *argv[], struct tcmd_handler_ctx *ctx)
+{
+	uint8_t i;
+
+	for (i = 0; argc == 3 && i < ARRAY_SIZE(policy_names); i++)
+		if (!strcmp(argv[2], policy_names[i]))
+			break;
+	if (argc != 3 || i == ARRAY_SIZE(policy_names)) {
+		TCMD_RSP_ERROR(ctx, "Usage: rawdata policy newest|oldest|throttle");
+		return;
+	}
+
+	rawdata_set_drop_policy(i);
+	TCMD_RSP_FINAL(ctx, NULL);
+}
+
+DECLARE_TEST_COMMAND(rawdata, policy, rawdata_tcmd_policy);
+
+/*
+ * Print the raw data streaming telemetry: rawdata stats
+ * Rates are in bytes/s, the connection interval in 1.25 ms units (0 if
+ * default).
+ *
+ * @param[in]   argc        Number of arguments in the Test Command (including group and name)
+ * @param[in]   argv        Table of null-terminated buffers containing the arguments
+ * @param[in]   ctx         The context to pass back to responses
+ */
+void rawdata_tcmd_stats(int argc, char *argv[], struct tcmd_handler_ctx *ctx)
+{
+	struct rawdata_stats stats;
+	char buf[64];
+
+	rawdata_get_stats(&stats);
+
+	snprintf(buf, sizeof(buf), "sampled %u stored %u streamed %u",
+		 (unsigned int)stats.sampled_rate,
+		 (unsigned int)stats.stored_rate,
+		 (unsigned int)stats.streamed_rate);
+	TCMD_RSP_PROVISIONAL(ctx, buf);
+	snprintf(buf, sizeof(buf), "backlog %u dropped %u/%u",
+		 (unsigned int)stats.backlog,
+		 (unsigned int)stats.dropped_reports,
+		 (unsigned int)stats.dropped_records);
+	TCMD_RSP_PROVISIONAL(ctx, buf);
+	snprintf(buf, sizeof(buf),
+		 "max push %d tx %d unacked %d requested interval %d",
+		 stats.pending_push_max, stats.pending_tx_max,
+		 stats.unacked_max, stats.requested_conn_interval);
+	TCMD_RSP_PROVISIONAL(ctx, buf);
+	snprintf(buf, sizeof(buf),
+		 "pool max %d dropped %u/%u throttle %d bursts %u",
+		 stats.pool_used_max,
+		 (unsigned int)stats.pool_dropped_newest,
+		 (unsigned int)stats.pool_dropped_oldest, stats.throttle,
+		 (unsigned int)stats.bursts);
+	TCMD_RSP_FINAL(ctx, buf);
+}
+
+DECLARE_TEST_COMMAND(rawdata, stats, rawdata_tcmd_stats);
+
+#ifdef RAWDATA_TRACE_ENABLE
+/* Events per dump line */
+#define TRACE_LINE_ENTRIES 4
+
+/*
+ * Dump the raw data pipeline trace: rawdata trace [clear]
+ * The events are printed oldest first, and removed from the trace, as
+ * "TR <time><event><arg> ..." lines: 32 kHz time on 8 hex digits, event on 2,
+ * argument on 4. The last line gives the number of events dumped and lost.
+ * clear drops the events instead. The trace is paused during the dump.
+ *
+ * @param[in]   argc        Number of arguments in the Test Command (including group and name)
+ * @param[in]   argv        Table of null-terminated buffers containing the arguments
+ * @param[in]   ctx         The context to pass back to responses
+ */
+void rawdata_tcmd_trace(int argc, char *argv[], struct tcmd_handler_ctx *ctx)
+{
+	struct rawdata_trace_entry entries[TRACE_LINE_ENTRIES];
+	char buf[4 + TRACE_LINE_ENTRIES * 15];
+	bool dump = argc == 2;
+	uint32_t nb_events = 0;
+	uint16_t count, i;
+	int len;
+
+	if (argc > 3 || (argc == 3 && strcmp(argv[2], "clear"))) {
+		TCMD_RSP_ERROR(ctx, "Usage: rawdata trace [clear]");
+		return;
+	}
+
+	rawdata_trace_pause(true);
+	while ((count = rawdata_trace_read(entries, TRACE_LINE_ENTRIES))) {
+		nb_events += count;
+		if (!dump)
+			continue;
+		len = snprintf(buf, sizeof(buf), "TR");
+		for (i = 0; i < count; i++)
+			len += snprintf(buf + len, sizeof(buf) - len,
+					" %08x%02x%04x",
+					(unsigned int)entries[i].time,
+					entries[i].event, entries[i].arg);
+		TCMD_RSP_PROVISIONAL(ctx, buf);
+	}
+	snprintf(buf, sizeof(buf), "%u events, %u lost",
+		 (unsigned int)nb_events, (unsigned int)rawdata_trace_lost());
+	rawdata_trace_pause(false);
+	TCMD_RSP_FINAL(ctx, buf);
+}
+
+DECLARE_TEST_COMMAND(rawdata, trace, rawdata_tcmd_trace);
+#endif
@@ -0,0 +1,95 @@
+/*
+ * Copyright (c) 2016, Intel Corporation. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ * this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ * this list of conditions and the following disclaimer in the documentation
+ * and/or other materials provided with the distribution.
+ *
+ * 3. Neither the name of the copyright holder nor the names of its contributors
+ * may be used to endorse or promote products derived from this software without
+ * specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include "os/os.h"
+#include "infra/time.h"
+
+#include "rawdata_trace.h"
+
+#ifdef RAWDATA_TRACE_ENABLE
+
+static struct trace_ring {
+	struct rawdata_trace_entry entries[RAWDATA_TRACE_ENTRIES];
+	uint16_t head;
+	uint16_t count;
+	uint32_t lost;
+	bool paused;
+} ring;
+
+void rawdata_trace_record(enum rawdata_trace_event event, uint16_t arg)
+{
+	struct rawdata_trace_entry *entry;
+	uint32_t saved = interrupt_lock();
+
+	if (ring.paused) {
+		interrupt_unlock(saved);
+		return;
+	}
+	if (ring.count == RAWDATA_TRACE_ENTRIES) {
+		ring.head = (ring.head + 1) % RAWDATA_TRACE_ENTRIES;
+		ring.count--;
+		ring.lost++;
+	}
+	entry = &ring.entries[(ring.head + ring.count) % RAWDATA_TRACE_ENTRIES];
+	entry->time = get_uptime_32k();
+	entry->arg = arg;
+	entry->event = event;
+	ring.count++;
+	interrupt_unlock(saved);
+}
+
+void rawdata_trace_pause(bool paused)
+{
+	ring.paused = paused;
+}
+
+uint16_t rawdata_trace_read(struct rawdata_trace_entry *entries, uint16_t max)
+{
+	uint16_t count = 0;
+	uint32_t saved = interrupt_lock();
+
+	while (ring.count && count < max) {
+		entries[count++] = ring.entries[ring.head];
+		ring.head = (ring.head + 1) % RAWDATA_TRACE_ENTRIES;
+		ring.count--;
+	}
+	interrupt_unlock(saved);
+	return count;
+}
+
+uint32_t rawdata_trace_lost(void)
+{
+	uint32_t lost = ring.lost;
+
+	ring.lost = 0;
+	return lost;
+}
+
+#endif /* RAWDATA_TRACE_ENABLE */
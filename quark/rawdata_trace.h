@@ -0,0 +1,96 @@
+/*
+ * Copyright (c) 2016, Intel Corporation. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ * this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ * this list of conditions and the following disclaimer in the documentation
+ * and/or other materials provided with the distribution.
+ *
+ * 3. Neither the name of the copyright holder nor the names of its contributors
+ * may be used to endorse or promote products derived from this software without
+ * specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef __RAWDATA_TRACE_H__
+#define __RAWDATA_TRACE_H__
+
+#include <stdbool.h>
+#include <stdint.h>
+
+/* Trace of the raw data pipeline.
+ * Each trace point stores its event ID, a 16 bits argument and the 32 kHz
+ * uptime in a RAM ring, which keeps the last RAWDATA_TRACE_ENTRIES events.
+ * The ring is dumped by TCMD rawdata trace and turned into a timeline by
+ * scripts/rawdata_trace.py.
+ *
+ * The trace points are only built with RAWDATA_TRACE_ENABLE defined.
+ */
+
+#define RAWDATA_TRACE_ENTRIES 256
+
+enum rawdata_trace_event {
+#define RAWDATA_TRACE_EVENT(name, argument) RAWDATA_TRACE_ ## name,
+#include "rawdata_trace_list.def"
+	RAWDATA_TRACE_EVENTS
+};
+
+struct rawdata_trace_entry {
+	/* Low 32 bits of the 32 kHz uptime */
+	uint32_t time;
+	uint16_t arg;
+	uint8_t event;
+};
+
+#ifdef RAWDATA_TRACE_ENABLE
+#define RAWDATA_TRACE(name, arg) \
+	rawdata_trace_record(RAWDATA_TRACE_ ## name, (arg))
+#else
+#define RAWDATA_TRACE(name, arg) do {} while (0)
+#endif
+
+/** Store an event in the ring, the oldest one is overwritten if it is full.
+ * Use the RAWDATA_TRACE() macro.
+ *
+ * @param event event ID
+ * @param arg event argument
+ */
+void rawdata_trace_record(enum rawdata_trace_event event, uint16_t arg);
+
+/** Pause the trace, while it is dumped.
+ *
+ * @param paused true to ignore the next events
+ */
+void rawdata_trace_pause(bool paused);
+
+/** Move the oldest events of the ring to entries.
+ *
+ * @param entries filled with the events, oldest first
+ * @param max size of entries
+ * @return the number of events read
+ */
+uint16_t rawdata_trace_read(struct rawdata_trace_entry *entries, uint16_t max);
+
+/** Get the number of events overwritten since the last call.
+ *
+ * @return the number of events lost
+ */
+uint32_t rawdata_trace_lost(void);
+
+#endif
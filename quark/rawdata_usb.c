@@ -0,0 +1,213 @@
+/*
+ * Copyright (c) 2016, Intel Corporation. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ * this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ * this list of conditions and the following disclaimer in the documentation
+ * and/or other materials provided with the distribution.
+ *
+ * 3. Neither the name of the copyright holder nor the names of its contributors
+ * may be used to endorse or promote products derived from this software without
+ * specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <string.h>
+
+#include <device.h>
+#include <uart.h>
+
+#include "os/os.h"
+#include "util/misc.h"
+#include "infra/log.h"
+
+#include "rawdata_usb.h"
+
+/* CDC-ACM port dedicated to raw data, the first one is used by the console */
+#ifndef RAWDATA_USB_PORT_NAME
+#define RAWDATA_USB_PORT_NAME   "CDC_ACM_1"
+#endif
+
+/* 1 byte for sync and 1 byte for length */
+#define FRAME_HEADER_SIZE       (2 * sizeof(uint8_t))
+
+/* Size of the TX ring, must be a power of 2 */
+#define TX_RING_SIZE            512
+/* Maximum number of frames in the TX ring, must be a power of 2 */
+#define TX_MAX_FRAMES           8
+
+/* Period of the DTR polling in ms, the CDC-ACM driver does not report the
+ * line state changes */
+#define LINE_POLL_PERIOD        500
+
+static struct device *acm_dev = NULL;
+static xloop_t *main_loop = NULL;
+static void (*tx_complete)(void) = NULL;
+static void (*line_changed)(bool opened) = NULL;
+
+/* DTR polling, only while the port is watched */
+static T_TIMER line_timer = NULL;
+static volatile bool line_opened = false;
+
+static uint8_t tx_ring[TX_RING_SIZE];
+/* Free running byte counters: tx_in is only written by the main task and
+ * tx_out by the interrupt handler */
+static volatile uint32_t tx_in = 0;
+static volatile uint32_t tx_out = 0;
+
+/* Value of tx_in at the end of each queued frame */
+static uint32_t frame_end[TX_MAX_FRAMES];
+static uint8_t frame_head = 0;
+static uint8_t frame_tail = 0;
+
+/* Set when a TX completion job is waiting in the main loop */
+static volatile bool tx_done_posted = false;
+
+/* Report the frames fully handed to the USB controller, in main loop context */
+static int tx_done_job(void *param)
+{
+	tx_done_posted = false;
+	while (frame_tail != frame_head &&
+	       (int32_t)(tx_out - frame_end[frame_tail % TX_MAX_FRAMES]) >= 0) {
+		frame_tail++;
+		if (tx_complete)
+			tx_complete();
+	}
+	return 0;
+}
+
+static void acm_isr(struct device *dev)
+{
+	uint32_t in = tx_in;
+	uint32_t out = tx_out;
+	uint32_t offset;
+	int sent;
+
+	uart_irq_update(dev);
+	if (!uart_irq_tx_ready(dev))
+		return;
+
+	if (in == out) {
+		uart_irq_tx_disable(dev);
+		return;
+	}
+
+	/* Send up to the end of the ring, the rest is sent on next interrupt */
+	offset = out % TX_RING_SIZE;
+	sent = uart_fifo_fill(dev, &tx_ring[offset],
+			      MIN(in - out, TX_RING_SIZE - offset));
+	if (sent <= 0)
+		return;
+
+	tx_out = out + sent;
+	if (!tx_done_posted) {
+		tx_done_posted = true;
+		xloop_post_func(main_loop, tx_done_job, NULL);
+	}
+}
+
+static void ring_copy(uint32_t pos, const uint8_t *data, uint32_t len)
+{
+	uint32_t offset = pos % TX_RING_SIZE;
+	uint32_t first = MIN(len, TX_RING_SIZE - offset);
+
+	memcpy(&tx_ring[offset], data, first);
+	memcpy(tx_ring, data + first, len - first);
+}
+
+int rawdata_usb_write(const void *data, uint8_t len)
+{
+	uint8_t header[FRAME_HEADER_SIZE] = { RAWDATA_USB_SYNC, len };
+	uint32_t in = tx_in;
+
+	if (!acm_dev)
+		return -1;
+	/* Flow control: refuse the record if the ring is full */
+	if ((uint8_t)(frame_head - frame_tail) >= TX_MAX_FRAMES ||
+	    TX_RING_SIZE - (in - tx_out) < FRAME_HEADER_SIZE + len)
+		return -1;
+
+	ring_copy(in, header, FRAME_HEADER_SIZE);
+	ring_copy(in + FRAME_HEADER_SIZE, data, len);
+	in += FRAME_HEADER_SIZE + len;
+	frame_end[frame_head % TX_MAX_FRAMES] = in;
+	frame_head++;
+	tx_in = in;
+
+	uart_irq_tx_enable(acm_dev);
+	return 0;
+}
+
+bool rawdata_usb_is_opened(void)
+{
+	uint32_t dtr = 0;
+
+	if (!acm_dev)
+		return false;
+	/* The host asserts DTR when it opens the port */
+	uart_line_ctrl_get(acm_dev, LINE_CTRL_DTR, &dtr);
+	return dtr != 0;
+}
+
+/* Report the line state change, in main loop context */
+static int line_job(void *param)
+{
+	if (line_changed)
+		line_changed(line_opened);
+	return 0;
+}
+
+static void line_timer_cb(void *param)
+{
+	bool opened = rawdata_usb_is_opened();
+
+	if (opened == line_opened)
+		return;
+	line_opened = opened;
+	xloop_post_func(main_loop, line_job, NULL);
+}
+
+void rawdata_usb_watch(bool enable)
+{
+	if (!line_timer)
+		return;
+	if (enable) {
+		line_opened = rawdata_usb_is_opened();
+		timer_start(line_timer, LINE_POLL_PERIOD, NULL);
+	} else {
+		timer_stop(line_timer, NULL);
+	}
+}
+
+void rawdata_usb_init(xloop_t *loop, void (*tx_complete_cb)(void),
+		      void (*line_changed_cb)(bool opened))
+{
+	main_loop = loop;
+	tx_complete = tx_complete_cb;
+	line_changed = line_changed_cb;
+
+	acm_dev = device_get_binding(RAWDATA_USB_PORT_NAME);
+	if (!acm_dev) {
+		pr_error(LOG_MODULE_MAIN, "Raw data USB port not found");
+		return;
+	}
+	uart_irq_callback_set(acm_dev, acm_isr);
+	line_timer = timer_create(line_timer_cb, NULL, LINE_POLL_PERIOD, true,
+				  false, NULL);
+}
@@ -0,0 +1,77 @@
+/*
+ * Copyright (c) 2016, Intel Corporation. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ * this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ * this list of conditions and the following disclaimer in the documentation
+ * and/or other materials provided with the distribution.
+ *
+ * 3. Neither the name of the copyright holder nor the names of its contributors
+ * may be used to endorse or promote products derived from this software without
+ * specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef __RAWDATA_USB_H__
+#define __RAWDATA_USB_H__
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "infra/xloop.h"
+
+/* Start of frame marker, each record is sent as:
+ * RAWDATA_USB_SYNC | record length | record */
+#define RAWDATA_USB_SYNC     0xA5
+
+/** Raw data USB transport init.
+ * This binds the raw data CDC-ACM port.
+ *
+ * @param loop main loop on which the TX completions are reported
+ * @param tx_complete_cb callback called once per record sent
+ * @param line_changed_cb callback called when the host opens or closes the
+ *        port, while it is watched
+ */
+void rawdata_usb_init(xloop_t *loop, void (*tx_complete_cb)(void),
+		      void (*line_changed_cb)(bool opened));
+
+/** Watch the opening and closing of the raw data CDC-ACM port.
+ * The DTR line is polled while the port is watched.
+ *
+ * @param enable true to start watching the port, false to stop
+ */
+void rawdata_usb_watch(bool enable);
+
+/** Check if a host has opened the raw data CDC-ACM port.
+ *
+ * @return true if the port is opened, false otherwise
+ */
+bool rawdata_usb_is_opened(void);
+
+/** Queue a record on the raw data CDC-ACM port.
+ * The TX complete callback is called once the record has been handed to the
+ * USB controller.
+ *
+ * @param data record to send
+ * @param len length of the record
+ * @return 0 on success, negative value if there is no room for the record
+ */
+int rawdata_usb_write(const void *data, uint8_t len);
+
+#endif
@@ -0,0 +1,391 @@
+/*
+ * Copyright (c) 2016, Intel Corporation. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ * this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ * this list of conditions and the following disclaimer in the documentation
+ * and/or other materials provided with the distribution.
+ *
+ * 3. Neither the name of the copyright holder nor the names of its contributors
+ * may be used to endorse or promote products derived from this software without
+ * specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <string.h>
+
+#include "os/os.h"
+#include "util/misc.h"
+#include "infra/log.h"
+
+#include "cfw/cfw.h"
+#include "services/properties_service/properties_service_api.h"
+
+#include "sensor_registry.h"
+#include "msg_lanes.h"
+#include "boot_timeline.h"
+#include "project_properties.h"
+
+#define NB_SENSOR_TYPES  (ON_BOARD_SENSOR_TYPE_END + 1)
+
+/* Rate of a subscription, frequency is 0 if none */
+struct sensor_rate {
+	uint16_t frequency;
+	uint16_t interval;
+};
+
+/* A sensor is subscribed at the highest frequency and the shortest interval
+ * requested by its consumers. The reports are decimated for each consumer by
+ * the ratio of the subscribed frequency to its own */
+static struct registry_sensor {
+	sensor_service_t handle;
+	/* Data type of the subscription, shared by the consumers */
+	uint8_t data_type;
+	/* Number of consumers subscribed */
+	uint8_t refcount;
+	/* Rate requested by each consumer */
+	struct sensor_rate requested[SENSOR_REGISTRY_CONSUMERS];
+	/* Reports to skip before the next one of each consumer */
+	uint16_t skip[SENSOR_REGISTRY_CONSUMERS];
+	/* Rate of the sensor service subscription */
+	struct sensor_rate subscribed;
+} sensors[NB_SENSOR_TYPES];
+
+static const struct sensor_registry_consumer *consumers[SENSOR_REGISTRY_CONSUMERS];
+
+/* Client */
+static cfw_client_t *client = NULL;
+
+/* Sensors client */
+static cfw_service_conn_t *sensor_service_conn = NULL;
+
+static cfw_service_conn_t *properties_service_conn = NULL;
+
+/* Sensor types to scan, and the ones already scanned */
+static struct scan_state {
+	uint32_t requested;
+	uint32_t scanned;
+} scan;
+
+/* Channel of the sensors found by the previous scans, kept in the properties
+ * service so that their handles are known before this boot scans them */
+static struct handle_cache {
+	/* Bit n is set if ch_ids[n] is valid */
+	uint32_t mask;
+	uint8_t ch_ids[32];
+} cache;
+
+/* Set once the stored cache is read, and if the property exists */
+static bool cache_read = false;
+static bool cache_stored = false;
+
+static void report_sensor(const struct sensor_registry_consumer *consumer,
+			  uint8_t sensor_type)
+{
+	if (consumer && consumer->scan_cb && sensor_type < 32 &&
+	    (consumer->sensor_mask & (1 << sensor_type)))
+		consumer->scan_cb(sensor_type, sensors[sensor_type].handle);
+}
+
+/* Rate covering the requests of all the consumers */
+static struct sensor_rate merged_rate(const struct registry_sensor *sensor)
+{
+	struct sensor_rate rate = { 0, 0 };
+	uint8_t i;
+
+	for (i = 0; i < SENSOR_REGISTRY_CONSUMERS; i++) {
+		const struct sensor_rate *r = &sensor->requested[i];
+
+		if (!r->frequency)
+			continue;
+		if (!rate.frequency || r->interval < rate.interval)
+			rate.interval = r->interval;
+		rate.frequency = MAX(rate.frequency, r->frequency);
+	}
+	return rate;
+}
+
+/* Subscribe the sensor at the rate of its consumers, re-subscribed when it
+ * changes */
+static void update_subscription(uint8_t sensor_type)
+{
+	struct registry_sensor *sensor = &sensors[sensor_type];
+	struct sensor_rate rate = merged_rate(sensor);
+
+	/* The requests are applied once the sensor service is opened */
+	if (!sensor_service_conn ||
+	    !memcmp(&rate, &sensor->subscribed, sizeof(rate)))
+		return;
+
+	if (sensor->subscribed.frequency)
+		sensor_service_unsubscribe_data(sensor_service_conn, NULL,
+						sensor->handle,
+						&sensor->data_type, 1);
+	if (rate.frequency)
+		sensor_service_subscribe_data(sensor_service_conn, NULL,
+					      sensor->handle,
+					      &sensor->data_type, 1,
+					      rate.frequency, rate.interval);
+	pr_debug(LOG_MODULE_MAIN, "Sensor %d: %d -> %d Hz, %d consumers",
+		 sensor_type, sensor->subscribed.frequency, rate.frequency,
+		 sensor->refcount);
+	sensor->subscribed = rate;
+	/* The decimation restarts with the next report */
+	memset(sensor->skip, 0, sizeof(sensor->skip));
+}
+
+static void handle_sensor_subscribe_data(struct cfw_message *msg)
+{
+	sensor_service_subscribe_data_event_t *p_evt =
+		(sensor_service_subscribe_data_event_t *)msg;
+	uint8_t sensor_type = GET_SENSOR_TYPE(p_evt->handle);
+	struct registry_sensor *sensor;
+	uint8_t i;
+
+	if (sensor_type >= NB_SENSOR_TYPES)
+		return;
+	sensor = &sensors[sensor_type];
+
+	for (i = 0; i < SENSOR_REGISTRY_CONSUMERS; i++) {
+		const struct sensor_registry_consumer *consumer = consumers[i];
+
+		if (!sensor->requested[i].frequency)
+			continue;
+		if (sensor->skip[i]) {
+			sensor->skip[i]--;
+			continue;
+		}
+		sensor->skip[i] = sensor->subscribed.frequency /
+				  sensor->requested[i].frequency - 1;
+		if (consumer && consumer->data_cb)
+			consumer->data_cb(sensor_type,
+					  &p_evt->sensor_data_header);
+	}
+}
+
+static void store_cache(void)
+{
+	if (cache_stored)
+		properties_service_write(properties_service_conn,
+					 PROJECT_PROPERTIES_SERVICE_ID,
+					 PROJECT_PROPERTY_SENSOR_HANDLES,
+					 &cache, sizeof(cache), NULL);
+	else
+		properties_service_add(properties_service_conn,
+				       PROJECT_PROPERTIES_SERVICE_ID,
+				       PROJECT_PROPERTY_SENSOR_HANDLES, false,
+				       &cache, sizeof(cache), NULL);
+	cache_stored = true;
+}
+
+/* Set the handle of a sensor and report it if it changed */
+static void set_handle(uint8_t sensor_type, uint8_t ch_id)
+{
+	sensor_service_t handle = GET_SENSOR_HANDLE(sensor_type, ch_id);
+	uint8_t i;
+
+	if (sensors[sensor_type].handle == handle)
+		return;
+	sensors[sensor_type].handle = handle;
+	for (i = 0; i < SENSOR_REGISTRY_CONSUMERS; i++)
+		report_sensor(consumers[i], sensor_type);
+}
+
+static void handle_start_scanning_evt(struct cfw_message *msg)
+{
+	sensor_service_scan_event_t *p_evt = (sensor_service_scan_event_t *)msg;
+	sensor_service_on_board_scan_data_t on_board_data =
+		p_evt->on_board_data;
+	uint8_t sensor_type = p_evt->sensor_type;
+
+	if (sensor_type >= NB_SENSOR_TYPES)
+		return;
+
+	boot_timeline_mark(BOOT_STEP_SENSORS);
+	set_handle(sensor_type, on_board_data.ch_id);
+
+	if (sensor_type >= 32 || ((cache.mask & (1 << sensor_type)) &&
+				  cache.ch_ids[sensor_type] ==
+				  on_board_data.ch_id))
+		return;
+	cache.mask |= 1 << sensor_type;
+	cache.ch_ids[sensor_type] = on_board_data.ch_id;
+	/* Stored once the previous cache is read, see handle_cache_read */
+	if (cache_read)
+		store_cache();
+}
+
+/* The sensors of the cache are usable at once, the scan of this boot
+ * updates them */
+static void handle_cache_read(struct cfw_message *msg)
+{
+	properties_service_read_rsp_msg_t *p_rsp =
+		(properties_service_read_rsp_msg_t *)msg;
+	struct handle_cache stored;
+	uint8_t i;
+
+	cache_read = true;
+	if (p_rsp->rsp_header.status != DRV_RC_OK ||
+	    p_rsp->property_size != sizeof(stored)) {
+		if (cache.mask)
+			store_cache();
+		return;
+	}
+	cache_stored = true;
+	memcpy(&stored, &p_rsp->start_of_values, sizeof(stored));
+
+	/* The sensors already found by the scan are kept */
+	for (i = 0; i < MIN(NB_SENSOR_TYPES, 32); i++) {
+		if (!(stored.mask & (1 << i)) || (cache.mask & (1 << i)))
+			continue;
+		cache.mask |= 1 << i;
+		cache.ch_ids[i] = stored.ch_ids[i];
+		set_handle(i, stored.ch_ids[i]);
+	}
+	if (memcmp(&stored, &cache, sizeof(cache)))
+		store_cache();
+}
+
+static void scan_sensors(void)
+{
+	uint32_t mask = scan.requested & ~scan.scanned;
+
+	if (!sensor_service_conn || !mask)
+		return;
+	scan.scanned |= mask;
+	sensor_service_start_scanning(sensor_service_conn, NULL, mask);
+}
+
+static void dispatch_msg(struct cfw_message *msg)
+{
+	switch (CFW_MESSAGE_ID(msg)) {
+	case MSG_ID_SENSOR_SERVICE_START_SCANNING_EVT:
+		handle_start_scanning_evt(msg);
+		break;
+	case MSG_ID_SENSOR_SERVICE_SUBSCRIBE_DATA_EVT:
+		handle_sensor_subscribe_data(msg);
+		break;
+	case MSG_ID_PROP_SERVICE_READ_RSP:
+		handle_cache_read(msg);
+		break;
+	default: break;
+	}
+	cfw_msg_free(msg);
+}
+
+static void handle_msg(struct cfw_message *msg, void *data)
+{
+	/* The sensor data is bulk, the scan events stay before it */
+	msg_lanes_post(MSG_LANE_BULK, msg, dispatch_msg);
+}
+
+static void service_connection_cb(cfw_service_conn_t *handle, void *param)
+{
+	uint8_t i;
+
+	if ((void *)PROPERTIES_SERVICE_ID == param) {
+		properties_service_conn = handle;
+		properties_service_read(handle, PROJECT_PROPERTIES_SERVICE_ID,
+					PROJECT_PROPERTY_SENSOR_HANDLES, NULL);
+		return;
+	}
+
+	/* ARC_SC_SVC_ID */
+	sensor_service_conn = handle;
+	scan_sensors();
+	/* Apply the subscriptions of the cached sensors */
+	for (i = 0; i < NB_SENSOR_TYPES; i++)
+		update_subscription(i);
+}
+
+void sensor_registry_register(enum sensor_registry_consumer_id id,
+			      const struct sensor_registry_consumer *consumer)
+{
+	uint8_t i;
+
+	consumers[id] = consumer;
+	sensor_registry_scan(consumer->sensor_mask);
+	for (i = 0; i < NB_SENSOR_TYPES; i++)
+		if (sensors[i].handle)
+			report_sensor(consumer, i);
+}
+
+void sensor_registry_scan(uint32_t sensor_mask)
+{
+	scan.requested |= sensor_mask;
+	scan_sensors();
+}
+
+sensor_service_t sensor_registry_get_handle(uint8_t sensor_type)
+{
+	if (sensor_type >= NB_SENSOR_TYPES)
+		return NULL;
+	return sensors[sensor_type].handle;
+}
+
+bool sensor_registry_subscribe(enum sensor_registry_consumer_id id,
+			       uint8_t sensor_type, uint8_t data_type,
+			       uint16_t frequency, uint16_t interval)
+{
+	struct registry_sensor *sensor;
+
+	if (sensor_type >= NB_SENSOR_TYPES || !sensors[sensor_type].handle ||
+	    !frequency)
+		return false;
+	sensor = &sensors[sensor_type];
+	/* The other consumers use another data type */
+	if (sensor->refcount > !!sensor->requested[id].frequency &&
+	    sensor->data_type != data_type)
+		return false;
+
+	if (!sensor->requested[id].frequency)
+		sensor->refcount++;
+	sensor->data_type = data_type;
+	sensor->requested[id].frequency = frequency;
+	sensor->requested[id].interval = interval;
+	update_subscription(sensor_type);
+	return true;
+}
+
+void sensor_registry_unsubscribe(enum sensor_registry_consumer_id id,
+				 uint8_t sensor_type)
+{
+	if (sensor_type >= NB_SENSOR_TYPES ||
+	    !sensors[sensor_type].requested[id].frequency)
+		return;
+
+	sensors[sensor_type].refcount--;
+	memset(&sensors[sensor_type].requested[id], 0,
+	       sizeof(sensors[sensor_type].requested[id]));
+	update_subscription(sensor_type);
+}
+
+void sensor_registry_init(T_QUEUE queue)
+{
+	client = cfw_client_init(queue, handle_msg, NULL);
+
+	/* Open the properties service, for the sensors found previously */
+	cfw_open_service_helper(client, PROPERTIES_SERVICE_ID,
+				service_connection_cb,
+				(void *)PROPERTIES_SERVICE_ID);
+
+	/* Open the sensor service */
+	cfw_open_service_helper(client, ARC_SC_SVC_ID,
+				service_connection_cb, (void *)ARC_SC_SVC_ID);
+}
@@ -0,0 +1,117 @@
+/*
+ * Copyright (c) 2016, Intel Corporation. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ * this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ * this list of conditions and the following disclaimer in the documentation
+ * and/or other materials provided with the distribution.
+ *
+ * 3. Neither the name of the copyright holder nor the names of its contributors
+ * may be used to endorse or promote products derived from this software without
+ * specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef __SENSOR_REGISTRY_H__
+#define __SENSOR_REGISTRY_H__
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "os/os.h"
+
+/* Main sensors API */
+#include "services/sensor_service/sensor_service.h"
+
+/* Internal consumers of the sensor data. The raw data sessions are only told
+ * about the sensors found: they subscribe through the raw data collector of
+ * the sensor core */
+enum sensor_registry_consumer_id {
+	SENSOR_REGISTRY_PVP,
+	SENSOR_REGISTRY_RAWDATA,
+	SENSOR_REGISTRY_CONSUMERS
+};
+
+struct sensor_registry_consumer {
+	/* Sensor types reported to scan_cb */
+	uint32_t sensor_mask;
+	/* Called when a sensor of the mask is found, may be NULL */
+	void (*scan_cb)(uint8_t sensor_type, sensor_service_t handle);
+	/* Called for the reports of the sensors subscribed by the consumer */
+	void (*data_cb)(uint8_t sensor_type,
+			sensor_service_sensor_data_header_t *data);
+};
+
+/** Sensor registry init.
+ * This opens the sensor service and scans the sensors requested by the
+ * consumers, once for all of them. The sensors found by the previous boots
+ * are read from the properties service and usable before the scan ends.
+ */
+void sensor_registry_init(T_QUEUE queue);
+
+/** Register a consumer.
+ * The sensors already found are reported to its scan callback.
+ *
+ * @param id consumer
+ * @param consumer callbacks, must stay valid
+ */
+void sensor_registry_register(enum sensor_registry_consumer_id id,
+			      const struct sensor_registry_consumer *consumer);
+
+/** Scan sensor types.
+ * The types of the registered consumers are scanned, the others must be
+ * requested. Each type is scanned once.
+ *
+ * @param sensor_mask sensor types to scan
+ */
+void sensor_registry_scan(uint32_t sensor_mask);
+
+/** Get the handle of a sensor.
+ *
+ * @param sensor_type sensor type
+ * @return the handle, NULL if the sensor is not found (yet)
+ */
+sensor_service_t sensor_registry_get_handle(uint8_t sensor_type);
+
+/** Subscribe a consumer to a sensor.
+ * A sensor is shared by its consumers: it is subscribed at the highest rate
+ * requested, and each consumer gets the reports decimated to its own
+ * frequency. A new rate of the same consumer replaces the previous one.
+ *
+ * @param id consumer
+ * @param sensor_type sensor type
+ * @param data_type data type of the subscription
+ * @param frequency sampling rate frequency in Hz
+ * @param interval reporting interval in ms
+ * @return false if the sensor is not found or subscribed by another
+ *         consumer with another data type
+ */
+bool sensor_registry_subscribe(enum sensor_registry_consumer_id id,
+			       uint8_t sensor_type, uint8_t data_type,
+			       uint16_t frequency, uint16_t interval);
+
+/** Unsubscribe a consumer from a sensor.
+ *
+ * @param id consumer
+ * @param sensor_type sensor type
+ */
+void sensor_registry_unsubscribe(enum sensor_registry_consumer_id id,
+				 uint8_t sensor_type);
+
+#endif
@@ -0,0 +1,122 @@
+#!/usr/bin/env python
+
+# Copyright (c) 2016, Intel Corporation. All rights reserved.
+#
+# Redistribution and use in source and binary forms, with or without
+# modification, are permitted provided that the following conditions are met:
+#
+# 1. Redistributions of source code must retain the above copyright notice,
+# this list of conditions and the following disclaimer.
+#
+# 2. Redistributions in binary form must reproduce the above copyright notice,
+# this list of conditions and the following disclaimer in the documentation
+# and/or other materials provided with the distribution.
+#
+# 3. Neither the name of the copyright holder nor the names of its contributors
+# may be used to endorse or promote products derived from this software without
+# specific prior written permission.
+#
+# THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+# AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+# IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+# ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+# LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+# CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+# SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+# INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+# CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+# ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+# POSSIBILITY OF SUCH DAMAGE.
+
+# Decode the binary log lines of a Quark log capture.
+#
+# The BINLOG() sites of the firmware only store a message ID, the uptime and
+# the integer arguments of each message. They are flushed to the log as hex
+# lines ("BL <words>"), formatted here with the messages of
+# quark/binlog_list.def:
+#   binlog_decode.py quark_log.txt
+#   cat /dev/ttyACM0 | binlog_decode.py -
+#
+# The other lines of the log are printed unchanged, unless --binary-only.
+# The binlog_list.def must be the one of the running firmware.
+
+import os
+import re
+import sys
+import argparse
+
+THIS_DIR = os.path.dirname(os.path.abspath(__file__))
+PROJECT_DIR = os.path.dirname(THIS_DIR)
+
+MSG_RE = re.compile(r'^BINLOG_MSG\(\s*(\w+)\s*,\s*(\w+)\s*,\s*(\w+)\s*,\s*"(.*)"\s*\)')
+LINE_RE = re.compile(r'\bBL ((?:[0-9a-f]{8} ?)+)')
+CONVERSION_RE = re.compile(r'%([-+ #0]*\d*)l*([diuxXc%])')
+
+def read_messages(path):
+    # Return the (name, level, format) of each message, by ID
+    messages = []
+    for line in open(path):
+        m = MSG_RE.search(line)
+        if m:
+            messages.append((m.group(1), m.group(3), m.group(4)))
+    return messages
+
+def format_message(fmt, args):
+    # Apply a C format to the raw 32 bits arguments
+    args = list(args)
+    def convert(m):
+        flags, conversion = m.group(1), m.group(2)
+        if conversion == '%':
+            return '%'
+        if not args:
+            return '<missing>'
+        value = args.pop(0)
+        if conversion in 'di' and value & 0x80000000:
+            value -= 1 << 32
+        elif conversion == 'u':
+            conversion = 'd'
+        return ('%' + flags + conversion)%value
+    return CONVERSION_RE.sub(convert, fmt)
+
+def decode_words(words, messages):
+    # Yield the decoded entries of the words of a line
+    i = 0
+    while i + 2 <= len(words):
+        msg_id, nargs = words[i] >> 16, words[i] & 0xFF
+        uptime = words[i + 1]
+        args = words[i + 2:i + 2 + nargs]
+        i += 2 + nargs
+        if msg_id >= len(messages):
+            yield '[%d] unknown message %d %s'%(uptime, msg_id,
+                                                 ' '.join('%x'%a for a in args))
+            continue
+        name, level, fmt = messages[msg_id]
+        yield '[%d] %s: %s'%(uptime, level, format_message(fmt, args))
+
+def decode(input_file, messages, binary_only):
+    for line in input_file:
+        m = LINE_RE.search(line)
+        if not m:
+            if not binary_only:
+                sys.stdout.write(line)
+            continue
+        words = [int(w, 16) for w in m.group(1).split()]
+        for entry in decode_words(words, messages):
+            print entry
+        sys.stdout.flush()
+
+if __name__ == "__main__":
+
+    parser = argparse.ArgumentParser()
+    parser.add_argument('input', action='store',
+                        help='log capture, - for stdin')
+    parser.add_argument('-d', '--definition', action='store',
+                        default=os.path.join(PROJECT_DIR, 'quark', 'binlog_list.def'),
+                        help='binlog_list.def of the firmware (the one of the project by default)')
+    parser.add_argument('-b', '--binary-only', action='store_true',
+                        help='only print the binary log entries')
+
+    args = parser.parse_args()
+    messages = read_messages(args.definition)
+    input_file = sys.stdin if args.input == '-' else open(args.input)
+    decode(input_file, messages, args.binary_only)
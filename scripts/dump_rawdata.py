@@ -57,17 +57,81 @@ def find_dfu(package):
         else:
             return ""
 
+# Features of a window of samples, see struct rawdata_features:
+# mean, variance, energy, min, max, zero crossings of each axis
+FEATURES_TYPE = 0x80
+FEATURE_AXIS_FORMAT = '<iIIiiH'
+
+# Rate of a sensor stream, see struct rawdata_stream_info:
+# sensor type, requested frequency in Hz, measured rate in mHz,
+# reporting interval in ms
+STREAM_INFO_TYPE = 0xF0
+STREAM_INFO_FORMAT = '<BHIH'
+
+# Sampling period in ms of each sensor type, from the stream info
+stream_periods = {}
+
+# Time anchor, see struct rawdata_time_anchor:
+# uptime in ms, RTC time in s
+TIME_ANCHOR_TYPE = 0xF1
+TIME_ANCHOR_FORMAT = '<QI'
+
+# Last time anchor, and time base of the decoded timestamps
+time_anchor = {'uptime': None, 'rtc_time': 0, 'wallclock': False}
+
+def set_wallclock (wallclock):
+    # Decode the timestamps as wall clock time in ms rather than uptime
+    time_anchor['wallclock'] = wallclock
+
+def decode_time_anchor (data):
+    anchor = unpack(TIME_ANCHOR_FORMAT, data[0:calcsize(TIME_ANCHOR_FORMAT)])
+    time_anchor['uptime'] = anchor[0]
+    time_anchor['rtc_time'] = anchor[1]
+    return anchor
+
+def record_time (timestamp):
+    # Extend the 32 bits record timestamp around the last anchor
+    if time_anchor['uptime'] is None:
+        return timestamp
+    delta = (timestamp - time_anchor['uptime']) & 0xFFFFFFFF
+    if delta >= 0x80000000:
+        delta = delta - 0x100000000
+    if time_anchor['wallclock']:
+        return time_anchor['rtc_time'] * 1000 + delta
+    return time_anchor['uptime'] + delta
+
+def decode_stream_info (data):
+    info = unpack(STREAM_INFO_FORMAT, data[0:calcsize(STREAM_INFO_FORMAT)])
+    if info[2]:
+        stream_periods[info[0]] = 1000000.0 / info[2]
+    return info
+
+def sample_time (timestamp, index, count, valtype, freq):
+    # The record timestamp is the one of its last sample
+    period = stream_periods.get(valtype, 1000.0 / freq)
+    return str(int(round(timestamp - (count - (index + 1)) * period)))
+
 def decode_data_sandbox (data, size, freq, fd):
-    timestamp = unpack('<I', data[0:4])[0]
+    timestamp = record_time(unpack('<I', data[0:4])[0])
     start = 4
     A = []
     G = []
+    meta = False
     while (start < size):
         valtype = unpack('<B', data[start])[0]
         if valtype == 0:
             break
         start = start + 1
         vallen = unpack('<B', data[start])[0]
+        if valtype == STREAM_INFO_TYPE:
+            decode_stream_info(data[start+1:start+1+vallen])
+        if valtype == TIME_ANCHOR_TYPE:
+            decode_time_anchor(data[start+1:start+1+vallen])
+        if valtype & FEATURES_TYPE:
+            # Only the samples are part of the sandbox output
+            meta = True
+            start = start + 1 + vallen
+            continue
         if valtype == 1:
             eltsize = 6
         elif valtype == 2:
@@ -94,22 +158,32 @@ def decode_data_sandbox (data, size, freq, fd):
             start = start + eltsize
 
     if (len(A) == 0 and len(G) == 0):
-        print "ERROR: No Accel and No gyro"
-    elif (len(A) == 0):
-        for i in range(len(G)):
-            fd.write(str(timestamp - ((len(G) - (i + 1)) * (1000 / freq))) + ',,,,' + G[i] + '\n')
-    elif (len(G) == 0):
+        if not meta:
+            print "ERROR: No Accel and No gyro"
+    elif (len(A) == len(G) and sample_time(timestamp, 0, len(A), 1, freq) == \
+          sample_time(timestamp, 0, len(G), 2, freq)):
         for i in range(len(A)):
-            fd.write(str(timestamp - ((len(A) - (i + 1)) * (1000 / freq))) + ',' + A[i] + ',,,\n')
-    elif (len(A) == len(G)):
-        for i in range(len(A)):
-            fd.write(str(timestamp - ((len(A) - (i + 1)) * (1000 / freq))) + ',' + A[i] + ',' + G[i] + '\n')
+            fd.write(sample_time(timestamp, i, len(A), 1, freq) + ',' + A[i] + ',' + G[i] + '\n')
     else:
-        print "ERROR: %d Accel and %d Gyro samples"%(len(A), len(G))
+        # Sensors sampled at different rates get their own lines
+        for i in range(len(A)):
+            fd.write(sample_time(timestamp, i, len(A), 1, freq) + ',' + A[i] + ',,,\n')
+        for i in range(len(G)):
+            fd.write(sample_time(timestamp, i, len(G), 2, freq) + ',,,,' + G[i] + '\n')
+
 
+def decode_features (data, timestamp, sensor_type, fd):
+    nb_samples = unpack('<H', data[0:2])[0]
+    axis_size = calcsize(FEATURE_AXIS_FORMAT)
+    A = str(nb_samples)
+    for axis in range(3):
+        offset = 2 + axis * axis_size
+        A = A + ';' + ','.join(str(v) for v in \
+            unpack(FEATURE_AXIS_FORMAT, data[offset:offset+axis_size]))
+    fd.write(str(timestamp) + ';F' + str(sensor_type) + ';' + A + '\n')
 
 def decode_data (data, size, fd):
-    timestamp = unpack('<I', data[0:4])[0]
+    timestamp = record_time(unpack('<I', data[0:4])[0])
     start = 4
     while (start < size):
         valtype = unpack('<B', data[start])[0]
@@ -117,6 +191,24 @@ def decode_data (data, size, fd):
             break
         start = start + 1
         vallen = unpack('<B', data[start])[0]
+        if valtype == STREAM_INFO_TYPE:
+            info = decode_stream_info(data[start+1:start+1+vallen])
+            fd.write(str(timestamp) + ';I' + str(info[0]) + ';' + \
+                     ';'.join(str(v) for v in info[1:]) + '\n')
+            start = start + 1 + vallen
+            continue
+        if valtype == TIME_ANCHOR_TYPE:
+            anchor = decode_time_anchor(data[start+1:start+1+vallen])
+            timestamp = record_time(unpack('<I', data[0:4])[0])
+            fd.write(str(timestamp) + ';T;' + \
+                     ';'.join(str(v) for v in anchor) + '\n')
+            start = start + 1 + vallen
+            continue
+        if valtype & FEATURES_TYPE:
+            decode_features(data[start+1:start+1+vallen], timestamp,
+                            valtype & ~FEATURES_TYPE, fd)
+            start = start + 1 + vallen
+            continue
         if valtype == 1:
             eltsize = 6
         elif valtype == 2:
@@ -167,6 +259,8 @@ if __name__ == "__main__":
                     action="store_true")
     parser.add_argument('-freq', '--frequency', action='store',
 			help='Sensor sampling rate frequency in Hz (100hz by default)')
+    parser.add_argument('-w', '--wallclock', action='store_true',
+                        help='decode the timestamps as wall clock time in ms')
 
     serial_flash_block_size = 4096
     user_data_nb_block = 506
@@ -188,6 +282,7 @@ if __name__ == "__main__":
     # 00000000 the element is read
 
     args = parser.parse_args()
+    set_wallclock(args.wallclock)
     action = args.action
     print "Param: " + action
 
@@ -0,0 +1,239 @@
+#!/usr/bin/env python
+
+# Copyright (c) 2016, Intel Corporation. All rights reserved.
+#
+# Redistribution and use in source and binary forms, with or without
+# modification, are permitted provided that the following conditions are met:
+#
+# 1. Redistributions of source code must retain the above copyright notice,
+# this list of conditions and the following disclaimer.
+#
+# 2. Redistributions in binary form must reproduce the above copyright notice,
+# this list of conditions and the following disclaimer in the documentation
+# and/or other materials provided with the distribution.
+#
+# 3. Neither the name of the copyright holder nor the names of its contributors
+# may be used to endorse or promote products derived from this software without
+# specific prior written permission.
+#
+# THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+# AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+# IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+# ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+# LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+# CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+# SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+# INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+# CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+# ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+# POSSIBILITY OF SUCH DAMAGE.
+
+# Host emulation of the pattern matching engine used by the KB classifier.
+#
+# The accel samples of a raw data capture decoded by dump_rawdata.py or
+# rawdata_usb_reader.py (<files_header>_data.csv) are cut in windows; each
+# window gives a feature vector of up to 128 bytes, the components of its
+# samples axis after axis scaled to 0..255. Vectors are classified by the
+# neurons of a knowledge file, one neuron per line: category;aif;components
+#
+#   kb_emulator.py learn square_data.csv -c 2 -k kb.txt
+#   kb_emulator.py classify stream_data.csv -k kb.txt -e 2
+#
+# The distances are computed with numpy (python-numpy package).
+
+import sys
+import time
+import argparse
+
+import numpy as np
+
+# Pattern matching engine limits
+NB_NEURONS = 128
+VECTOR_SIZE = 128
+MIN_IF = 2
+MAX_IF = 0x4000
+
+ACCEL_TYPE = 1
+
+def read_accel(path):
+    # Return the timestamps and the (x, y, z) samples of the accel
+    timestamps = []
+    samples = []
+    for line in open(path):
+        values = line.strip().split(';')
+        if len(values) != 5 or values[1] != str(ACCEL_TYPE):
+            continue
+        timestamps.append(int(values[0]))
+        samples.append([int(v) for v in values[2:5]])
+    return np.array(timestamps, dtype=np.int64), \
+        np.array(samples, dtype=np.int32).reshape(-1, 3)
+
+def feature_vectors(timestamps, samples, window, step):
+    # Return the timestamp of the last sample and the vector of each window
+    if window * 3 > VECTOR_SIZE:
+        raise ValueError('window above %d samples' % (VECTOR_SIZE // 3))
+    starts = np.arange(0, len(samples) - window + 1, step)
+    if not len(starts):
+        return np.zeros(0, dtype=np.int64), \
+            np.zeros((0, window * 3), dtype=np.int32)
+    index = starts[:, None] + np.arange(window)[None, :]
+    # Axis after axis, 16-bit samples scaled to a byte
+    vectors = samples[index].transpose(0, 2, 1).reshape(len(starts), -1)
+    vectors = np.clip((vectors + 32768) >> 8, 0, 255)
+    return timestamps[starts + window - 1], vectors
+
+class PatternMatcher(object):
+
+    def __init__(self, norm='l1', knn=False):
+        self.norm = norm
+        self.knn = knn
+        self.components = np.zeros((0, 0), dtype=np.int32)
+        self.categories = np.zeros(0, dtype=np.int32)
+        self.aifs = np.zeros(0, dtype=np.int32)
+
+    def load(self, path):
+        neurons = [line.strip().split(';') for line in open(path)
+                   if line.strip() and not line.startswith('#')]
+        self.categories = np.array([int(n[0]) for n in neurons], dtype=np.int32)
+        self.aifs = np.array([int(n[1]) for n in neurons], dtype=np.int32)
+        self.components = np.array([[int(c) for c in n[2].split(',')]
+                                    for n in neurons], dtype=np.int32)
+
+    def save(self, path):
+        fd = open(path, 'w')
+        for category, aif, components in zip(self.categories, self.aifs,
+                                             self.components):
+            fd.write('%d;%d;%s\n' % (category, aif,
+                                     ','.join(str(c) for c in components)))
+        fd.close()
+
+    def distances(self, vectors, chunk=256):
+        # Distances between each vector and each neuron, chunked to bound
+        # the size of the broadcast differences
+        result = np.zeros((len(vectors), len(self.categories)), dtype=np.int32)
+        for start in range(0, len(vectors), chunk):
+            diff = np.abs(vectors[start:start+chunk, None, :] -
+                          self.components[None, :, :])
+            if self.norm == 'lsup':
+                result[start:start+chunk] = diff.max(axis=2)
+            else:
+                result[start:start+chunk] = diff.sum(axis=2)
+        return result
+
+    def classify(self, vectors):
+        # Category of the closest neuron, among the firing ones in RBF
+        # mode; 0 when no neuron fires
+        if not len(self.categories):
+            return np.zeros(len(vectors), dtype=np.int32)
+        dist = self.distances(vectors)
+        if not self.knn:
+            dist = np.where(dist < self.aifs[None, :], dist, np.iinfo(np.int32).max)
+        nearest = dist.argmin(axis=1)
+        found = dist[np.arange(len(vectors)), nearest] != np.iinfo(np.int32).max
+        return np.where(found, self.categories[nearest], 0)
+
+    def learn(self, vector, category):
+        # RBF learning: shrink the influence field of the neurons of other
+        # categories firing on the vector, commit a neuron if none of the
+        # category fires
+        if len(self.categories):
+            dist = self.distances(vector[None, :])[0]
+            firing = dist < self.aifs
+            wrong = firing & (self.categories != category)
+            self.aifs[wrong] = np.maximum(dist[wrong], MIN_IF)
+            if (firing & (self.categories == category)).any():
+                return False
+            others = dist[self.categories != category]
+            aif = min(others.min(), MAX_IF) if len(others) else MAX_IF
+        else:
+            aif = MAX_IF
+        if len(self.categories) >= NB_NEURONS:
+            print ('WARNING: all the neurons are committed')
+            return False
+        if not len(self.categories):
+            self.components = np.zeros((0, len(vector)), dtype=np.int32)
+        self.components = np.vstack([self.components, vector])
+        self.categories = np.append(self.categories, category).astype(np.int32)
+        self.aifs = np.append(self.aifs, max(aif, MIN_IF)).astype(np.int32)
+        return True
+
+def learn(args, engine):
+    try:
+        engine.load(args.knowledge)
+    except IOError:
+        pass
+    committed = 0
+    for path in args.files:
+        _, vectors = feature_vectors(*read_accel(path), window=args.window,
+                                     step=args.step)
+        for vector in vectors:
+            if engine.learn(vector, args.category):
+                committed = committed + 1
+    engine.save(args.knowledge)
+    print ('%d neurons committed, %d in the knowledge' %
+           (committed, len(engine.categories)))
+
+def classify(args, engine):
+    engine.load(args.knowledge)
+    out = open(args.output, 'w') if args.output else None
+    nb_vectors = 0
+    nb_expected = 0
+    duration = 0
+    counts = {}
+    for path in args.files:
+        timestamps, vectors = feature_vectors(*read_accel(path),
+                                              window=args.window,
+                                              step=args.step)
+        start = time.time()
+        categories = engine.classify(vectors)
+        duration = duration + time.time() - start
+        nb_vectors = nb_vectors + len(vectors)
+        for category in categories:
+            counts[category] = counts.get(category, 0) + 1
+        if args.expected is not None:
+            nb_expected = nb_expected + (categories == args.expected).sum()
+        if out:
+            for timestamp, category in zip(timestamps, categories):
+                out.write('%d;%d\n' % (timestamp, category))
+
+    print ('%d vectors, %d neurons (%s, %s)' %
+           (nb_vectors, len(engine.categories), args.norm,
+            'KNN' if args.knn else 'RBF'))
+    for category in sorted(counts):
+        print ('    category %d: %d' % (category, counts[category]))
+    if args.expected is not None and nb_vectors:
+        print ('Accuracy: %.1f%%' % (100.0 * nb_expected / nb_vectors))
+    if duration > 0:
+        print ('Throughput: %d classifications/s' % (nb_vectors / duration))
+
+if __name__ == "__main__":
+
+    parser = argparse.ArgumentParser()
+    parser.add_argument('action', action='store', choices=['learn', 'classify'],
+                        help='learn vectors of a category or classify vectors')
+    parser.add_argument('files', action='store', nargs='+',
+                        help='decoded raw data files (<files_header>_data.csv)')
+    parser.add_argument('-k', '--knowledge', action='store', required=True,
+                        help='knowledge file, extended by learn')
+    parser.add_argument('-c', '--category', action='store', type=int, default=1,
+                        help='category of the learnt vectors (1 by default)')
+    parser.add_argument('-e', '--expected', action='store', type=int,
+                        help='expected category, to report the accuracy')
+    parser.add_argument('-w', '--window', action='store', type=int, default=42,
+                        help='samples per vector (42 by default)')
+    parser.add_argument('-s', '--step', action='store', type=int, default=21,
+                        help='samples between two vectors (21 by default)')
+    parser.add_argument('-n', '--norm', action='store', choices=['l1', 'lsup'],
+                        default='l1', help='distance norm (l1 by default)')
+    parser.add_argument('--knn', action='store_true',
+                        help='KNN mode, RBF by default')
+    parser.add_argument('-o', '--output', action='store',
+                        help='write the timestamp;category of each vector')
+
+    args = parser.parse_args()
+    engine = PatternMatcher(args.norm, args.knn)
+
+    if args.action == 'learn':
+        learn(args, engine)
+    else:
+        classify(args, engine)
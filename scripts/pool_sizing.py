@@ -0,0 +1,224 @@
+#!/usr/bin/env python
+
+# Copyright (c) 2016, Intel Corporation. All rights reserved.
+#
+# Redistribution and use in source and binary forms, with or without
+# modification, are permitted provided that the following conditions are met:
+#
+# 1. Redistributions of source code must retain the above copyright notice,
+# this list of conditions and the following disclaimer.
+#
+# 2. Redistributions in binary form must reproduce the above copyright notice,
+# this list of conditions and the following disclaimer in the documentation
+# and/or other materials provided with the distribution.
+#
+# 3. Neither the name of the copyright holder nor the names of its contributors
+# may be used to endorse or promote products derived from this software without
+# specific prior written permission.
+#
+# THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+# AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+# IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+# ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+# LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+# CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+# SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+# INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+# CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+# ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+# POSSIBILITY OF SUCH DAMAGE.
+
+# Size the memory pools of each core from the balloc statistics of a run.
+#
+# 1. Run a representative raw data session and capture the pool statistics
+#    printed by the pool TCMD of each core (CONFIG_DBG_POOL_TCMD with
+#    CONFIG_MEMORY_POOLS_BALLOC_STATISTICS), "debug pool" on the Quark and
+#    "arc.debug pool" for the sensor core, forwarded by the Quark console:
+#      pool_sizing.py capture /dev/ttyACM0 -o quark_pools.txt
+#      pool_sizing.py capture /dev/ttyACM0 -c "arc.debug pool" -o arc_pools.txt
+# 2. Emit the memory_pool_list.def of each core:
+#      pool_sizing.py size quark_pools.txt --core quark -o quark/memory_pool_list.def
+#
+# Each statistics line is expected to give the block size, the block count and
+# the maximum number of blocks used, as the first, second and last numbers of
+# the line. Use --regex with the size, count and max named groups if the
+# TCMD output differs. A pool whose maximum reached its count was starved: the
+# allocations failed or waited, so it is doubled.
+
+import os
+import re
+import sys
+import tty
+import time
+import argparse
+from select import select
+
+THIS_DIR = os.path.dirname(os.path.abspath(__file__))
+PROJECT_DIR = os.path.dirname(THIS_DIR)
+
+POOL_RE = re.compile(r'DECLARE_MEMORY_POOL\(\s*(\d+)\s*,\s*(\d+)\s*,\s*(\d+)')
+
+# RAM size in kB of each core, from project_mapping.h
+RAM_SIZE_DEFINES = {
+    'quark': 'QUARK_RAM_SIZE',
+    'arc': 'CONFIG_QUARK_SE_ARC_RAM_SIZE',
+}
+
+def read_pools(path):
+    # Return the pools of a memory_pool_list.def as [size, count] and the
+    # comment header of the file
+    pools = []
+    header = []
+    for line in open(path):
+        m = POOL_RE.search(line)
+        if m:
+            pools.append([int(m.group(2)), int(m.group(3))])
+        elif not pools and not line.startswith('#undef'):
+            header.append(line)
+    return pools, ''.join(header)
+
+def read_ram_size(core):
+    path = os.path.join(PROJECT_DIR, 'include', 'project_mapping.h')
+    define = re.compile(r'#define\s+' + RAM_SIZE_DEFINES[core] + r'\s+(\d+)')
+    for line in open(path):
+        m = define.search(line)
+        if m:
+            return int(m.group(1)) * 1024
+    return 0
+
+def read_stats(path, sizes, regex):
+    # Return the maximum number of blocks used for each pool size
+    stats = {}
+    for line in open(path):
+        if regex:
+            m = regex.search(line)
+            if not m:
+                continue
+            size = int(m.group('size'))
+            count = int(m.group('count'))
+            used = int(m.group('max'))
+        else:
+            values = [int(v) for v in re.findall(r'\d+', line)]
+            if len(values) < 3 or values[0] not in sizes:
+                continue
+            size, count, used = values[0], values[1], values[-1]
+        stats[size] = (count, max(used, stats.get(size, (0, 0))[1]))
+    return stats
+
+def report(message):
+    # Keep stdout for the generated definition
+    print >> sys.stderr, message
+
+def check_stats(pools, stats):
+    for size, _ in pools:
+        if size not in stats:
+            report('WARNING: no statistics for the %d bytes pool, kept'%size)
+        elif stats[size][1] >= stats[size][0]:
+            report('WARNING: the %d bytes pool was starved (%d blocks), doubled'%(
+                size, stats[size][0]))
+
+def size_pools(pools, stats, margin):
+    # Return the new block count of each pool
+    counts = []
+    for size, count in pools:
+        if size not in stats:
+            counts.append(count)
+            continue
+        run_count, used = stats[size]
+        if used >= run_count:
+            # Starved during the run: the real need is unknown
+            counts.append(run_count * 2)
+        else:
+            counts.append(max(1, used + (used * margin + 99) / 100))
+    return counts
+
+def pools_ram(pools, counts):
+    return sum(size * count for (size, _), count in zip(pools, counts))
+
+def size(args):
+    def_path = args.definition or \
+        os.path.join(PROJECT_DIR, args.core, 'memory_pool_list.def')
+    pools, header = read_pools(def_path)
+    regex = re.compile(args.regex) if args.regex else None
+    stats = read_stats(args.stats, [p[0] for p in pools], regex)
+
+    # The current pools are known to fit: they are the default budget
+    budget = args.budget or pools_ram(pools, [p[1] for p in pools])
+    ram_size = read_ram_size(args.core)
+    if ram_size and budget > ram_size:
+        report('ERROR: budget of %d bytes above the %d bytes of RAM'%(budget, ram_size))
+        exit(1)
+
+    check_stats(pools, stats)
+    margin = args.margin
+    counts = size_pools(pools, stats, margin)
+    # Give up the margin before giving up the budget
+    while pools_ram(pools, counts) > budget and margin > 0:
+        margin = max(0, margin - 5)
+        counts = size_pools(pools, stats, margin)
+    if pools_ram(pools, counts) > budget:
+        report('ERROR: %d bytes needed, %d bytes short of the budget'%(
+            pools_ram(pools, counts), pools_ram(pools, counts) - budget))
+        exit(1)
+
+    report('Pool     old   max   new')
+    for (size, count), new in zip(pools, counts):
+        used = stats.get(size, (0, '-'))[1]
+        report('%4d B %5d %5s %5d'%(size, count, used, new))
+    report('RAM: %d -> %d bytes (budget %d, margin %d%%)'%(
+        pools_ram(pools, [p[1] for p in pools]), pools_ram(pools, counts),
+        budget, margin))
+
+    out = open(args.output, 'w') if args.output else sys.stdout
+    out.write(header)
+    for i, ((size, _), count) in enumerate(zip(pools, counts)):
+        out.write('DECLARE_MEMORY_POOL(%d,%d,%d)\n'%(i, size, count))
+    out.write('\n#undef DECLARE_MEMORY_POOL\n')
+
+def capture(args):
+    # Send the pool TCMD on the console and save its answer
+    fd = os.open(args.port, os.O_RDWR | os.O_NOCTTY)
+    tty.setraw(fd)
+    os.write(fd, args.command + '\n')
+    output = ''
+    end = time.time() + args.timeout
+    while time.time() < end:
+        ready, _, _ = select([fd], [], [], end - time.time())
+        if not ready:
+            break
+        output += os.read(fd, 1024)
+    os.close(fd)
+    out = open(args.output, 'w') if args.output else sys.stdout
+    out.write(output)
+
+if __name__ == "__main__":
+
+    parser = argparse.ArgumentParser()
+    parser.add_argument('action', action='store', choices=['capture', 'size'],
+                        help='capture the pool statistics or size the pools')
+    parser.add_argument('input', action='store',
+                        help='TCMD console port to capture, or captured statistics to size from')
+    parser.add_argument('-o', '--output', action='store',
+                        help='output file (stdout by default)')
+    parser.add_argument('-c', '--command', action='store', default='debug pool',
+                        help='pool statistics TCMD ("debug pool" by default, "arc.debug pool" for the sensor core)')
+    parser.add_argument('-t', '--timeout', action='store', type=float, default=2,
+                        help='capture duration in s (2 by default)')
+    parser.add_argument('--core', action='store', choices=['quark', 'arc'],
+                        default='quark', help='core of the statistics (quark by default)')
+    parser.add_argument('-d', '--definition', action='store',
+                        help='memory_pool_list.def to resize (the one of the core by default)')
+    parser.add_argument('-m', '--margin', action='store', type=int, default=25,
+                        help='margin above the maximum usage in %% (25 by default)')
+    parser.add_argument('-b', '--budget', action='store', type=int, default=0,
+                        help='RAM budget of the pools in bytes (current pools by default)')
+    parser.add_argument('--regex', action='store',
+                        help='regex of a statistics line, with size, count and max groups')
+
+    args = parser.parse_args()
+    args.port = args.stats = args.input
+
+    if args.action == 'capture':
+        capture(args)
+    else:
+        size(args)
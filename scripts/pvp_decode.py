@@ -0,0 +1,121 @@
+#!/usr/bin/env python
+
+# Copyright (c) 2016, Intel Corporation. All rights reserved.
+#
+# Redistribution and use in source and binary forms, with or without
+# modification, are permitted provided that the following conditions are met:
+#
+# 1. Redistributions of source code must retain the above copyright notice,
+# this list of conditions and the following disclaimer.
+#
+# 2. Redistributions in binary form must reproduce the above copyright notice,
+# this list of conditions and the following disclaimer in the documentation
+# and/or other materials provided with the distribution.
+#
+# 3. Neither the name of the copyright holder nor the names of its contributors
+# may be used to endorse or promote products derived from this software without
+# specific prior written permission.
+#
+# THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+# AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+# IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+# ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+# LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+# CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+# SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+# INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+# CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+# ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+# POSSIBILITY OF SUCH DAMAGE.
+
+# Decode the KB classifier records of the PVP events partition.
+#
+# The partition is a circular storage of struct pvp_record (see
+# quark/pvp_events_generator.h): results records of up to 32 consecutive
+# classifier results, and histogram records counting the results of each
+# class over a bucket. Read the partition with dfu-util, then:
+#   pvp_decode.py pvp_events_part.bin
+#   pvp_decode.py pvp_events_part.bin --all -o classifier.csv
+#
+# Each record is printed on one line, ordered by RTC time:
+#   <start>;R;<count>;<class of each result>
+#   <start>;H;<duration>;<count of each class>
+
+import sys
+import argparse
+from struct import *
+
+BLOCK_SIZE = 4096
+# Block header: magic, element size, write and read pointer status
+BLOCK_HEADER_FORMAT = '<HHII'
+BLOCK_MAGIC = 0xABCD
+# Status of each element
+ELEMENT_STATUS_SIZE = 4
+ELEMENT_WRITTEN = '\xBB\xBB\xBB\xBB'
+ELEMENT_READ = '\x00\x00\x00\x00'
+
+# Record types, see enum pvp_record_type
+RECORD_RESULTS = 1
+RECORD_HISTOGRAM = 2
+# struct pvp_results: RTC start, count, labels
+RESULTS_FORMAT = '<IB'
+BATCH_SIZE = 32
+# struct pvp_histogram: RTC start, duration, count of each class
+HISTOGRAM_FORMAT = '<IH8H'
+
+def read_elements(data, read_too):
+    # Return the elements written in the partition
+    elements = []
+    for offset in range(0, len(data) - BLOCK_SIZE + 1, BLOCK_SIZE):
+        block = data[offset:offset + BLOCK_SIZE]
+        header = unpack(BLOCK_HEADER_FORMAT, block[0:calcsize(BLOCK_HEADER_FORMAT)])
+        if header[0] != BLOCK_MAGIC:
+            continue
+        elt_size = header[1]
+        start = calcsize(BLOCK_HEADER_FORMAT)
+        while start + ELEMENT_STATUS_SIZE + elt_size <= BLOCK_SIZE:
+            status = block[start:start + ELEMENT_STATUS_SIZE]
+            if status == ELEMENT_WRITTEN or (read_too and status == ELEMENT_READ):
+                elements.append(block[start + ELEMENT_STATUS_SIZE:
+                                      start + ELEMENT_STATUS_SIZE + elt_size])
+            start = start + ELEMENT_STATUS_SIZE + elt_size
+    return elements
+
+def decode_record(element):
+    # Return the RTC time and the line of a record, None if unknown
+    record_type = unpack('<B', element[0])[0]
+    body = element[1:]
+    if record_type == RECORD_RESULTS:
+        start, count = unpack(RESULTS_FORMAT, body[0:calcsize(RESULTS_FORMAT)])
+        offset = calcsize(RESULTS_FORMAT)
+        labels = unpack('<%dB'%BATCH_SIZE, body[offset:offset + BATCH_SIZE])
+        return start, '%d;R;%d;%s'%(start, count,
+                                    ','.join(str(l) for l in labels[:count]))
+    if record_type == RECORD_HISTOGRAM:
+        histogram = unpack(HISTOGRAM_FORMAT, body[0:calcsize(HISTOGRAM_FORMAT)])
+        return histogram[0], '%d;H;%d;%s'%(histogram[0], histogram[1],
+                                           ','.join(str(c) for c in histogram[2:]))
+    return None
+
+if __name__ == "__main__":
+
+    parser = argparse.ArgumentParser()
+    parser.add_argument('partition', action='store',
+                        help='binary dump of the PVP events partition')
+    parser.add_argument('-a', '--all', action='store_true',
+                        help='also decode the records already read')
+    parser.add_argument('-o', '--output', action='store',
+                        help='output file (stdout by default)')
+
+    args = parser.parse_args()
+    data = open(args.partition, 'rb').read()
+    records = []
+    for element in read_elements(data, args.all):
+        record = decode_record(element)
+        if record:
+            records.append(record)
+    records.sort(key=lambda record: record[0])
+
+    fd = open(args.output, 'w') if args.output else sys.stdout
+    for start, line in records:
+        fd.write(line + '\n')
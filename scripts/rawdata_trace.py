@@ -0,0 +1,160 @@
+#!/usr/bin/env python
+
+# Copyright (c) 2016, Intel Corporation. All rights reserved.
+#
+# Redistribution and use in source and binary forms, with or without
+# modification, are permitted provided that the following conditions are met:
+#
+# 1. Redistributions of source code must retain the above copyright notice,
+# this list of conditions and the following disclaimer.
+#
+# 2. Redistributions in binary form must reproduce the above copyright notice,
+# this list of conditions and the following disclaimer in the documentation
+# and/or other materials provided with the distribution.
+#
+# 3. Neither the name of the copyright holder nor the names of its contributors
+# may be used to endorse or promote products derived from this software without
+# specific prior written permission.
+#
+# THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+# AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+# IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+# ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+# LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+# CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+# SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+# INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+# CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+# ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+# POSSIBILITY OF SUCH DAMAGE.
+
+# Turn a raw data pipeline trace into a timeline.
+#
+# Build the Quark with RAWDATA_TRACE_ENABLE defined, run a session and capture
+# the output of TCMD "rawdata trace" (several dumps may follow each other):
+#   rawdata_trace.py trace.txt
+#   rawdata_trace.py trace.txt --csv > trace.csv
+#
+# The timeline gives each event with its time from the first one and from the
+# previous one in ms. The summary gives the latency of each pipeline stage
+# (push, peek and transport, sent to acknowledged), the failed transport
+# writes, which have no completion, and the stalls: the gaps longer than --gap
+# ms without any event, with the events around them.
+# The events are listed in quark/rawdata_trace_list.def.
+
+import os
+import re
+import sys
+import argparse
+
+THIS_DIR = os.path.dirname(os.path.abspath(__file__))
+PROJECT_DIR = os.path.dirname(THIS_DIR)
+
+EVENT_RE = re.compile(r'^RAWDATA_TRACE_EVENT\(\s*(\w+)\s*,\s*"(.*)"\s*\)')
+LINE_RE = re.compile(r'\bTR((?: [0-9a-f]{14})+)')
+
+TICKS_PER_MS = 32.768
+
+# Pipeline stages: start and end events, matched in order
+STAGES = [
+    ('push', 'PUSH_SENT', 'PUSH_ACKED'),
+    ('peek', 'PEEK_SENT', 'PEEK_ACKED'),
+    ('transport', 'TRANSPORT_WRITE', 'TX_COMPLETE'),
+]
+
+def read_events(path):
+    # Return the (name, argument) of each event, by ID
+    events = []
+    for line in open(path):
+        m = EVENT_RE.search(line)
+        if m:
+            events.append((m.group(1), m.group(2)))
+    return events
+
+def read_trace(input_file, events):
+    # Return the entries as [time in ms, event name, argument]
+    entries = []
+    base = None
+    high = 0
+    last = None
+    for line in input_file:
+        m = LINE_RE.search(line)
+        if not m:
+            continue
+        for word in m.group(1).split():
+            time, event, arg = int(word[:8], 16), int(word[8:10], 16), int(word[10:], 16)
+            # Extend the 32 bits time
+            if last is not None and time < last:
+                high += 1 << 32
+            last = time
+            time += high
+            if base is None:
+                base = time
+            name = events[event][0] if event < len(events) else 'EVENT_%d'%event
+            entries.append([(time - base) / TICKS_PER_MS, name, arg])
+    return entries
+
+def print_timeline(entries, events):
+    arguments = dict(events)
+    previous = 0
+    for time, name, arg in entries:
+        print '%10.3f ms %+9.3f  %-16s %5d  %s'%(time, time - previous, name, arg,
+                                                  arguments.get(name, ''))
+        previous = time
+
+def print_csv(entries):
+    print 'time_ms,event,arg'
+    for time, name, arg in entries:
+        print '%.3f,%s,%d'%(time, name, arg)
+
+def print_summary(entries, gap):
+    print
+    print 'Stage        count    min ms    avg ms    max ms'
+    for stage, start, end in STAGES:
+        pending = []
+        latencies = []
+        for time, name, arg in entries:
+            if name == start:
+                pending.append(time)
+            elif name == end and pending:
+                latencies.append(time - pending.pop(0))
+        if latencies:
+            print '%-10s %7d %9.3f %9.3f %9.3f'%(stage, len(latencies),
+                min(latencies), sum(latencies) / len(latencies), max(latencies))
+        else:
+            print '%-10s %7d'%(stage, 0)
+    failures = [arg for time, name, arg in entries if name == 'TRANSPORT_FAIL']
+    if failures:
+        print '%d transport writes failed (errors %s)'%(len(failures),
+            ', '.join(str(-e) for e in sorted(set(failures))))
+
+    stalls = [(entries[i - 1], entries[i]) for i in range(1, len(entries))
+              if entries[i][0] - entries[i - 1][0] > gap]
+    print
+    print '%d stalls above %.1f ms'%(len(stalls), gap)
+    for before, after in stalls:
+        print '%10.3f ms %9.3f ms  %s -> %s'%(before[0], after[0] - before[0],
+                                              before[1], after[1])
+
+if __name__ == "__main__":
+
+    parser = argparse.ArgumentParser()
+    parser.add_argument('input', action='store',
+                        help='capture of the trace dumps, - for stdin')
+    parser.add_argument('-d', '--definition', action='store',
+                        default=os.path.join(PROJECT_DIR, 'quark', 'rawdata_trace_list.def'),
+                        help='rawdata_trace_list.def of the firmware (the one of the project by default)')
+    parser.add_argument('-g', '--gap', action='store', type=float, default=50,
+                        help='minimum duration of a stall in ms (50 by default)')
+    parser.add_argument('--csv', action='store_true',
+                        help='print the events as CSV, without the summary')
+
+    args = parser.parse_args()
+    events = read_events(args.definition)
+    input_file = sys.stdin if args.input == '-' else open(args.input)
+    entries = read_trace(input_file, events)
+    if args.csv:
+        print_csv(entries)
+    else:
+        print_timeline(entries, events)
+        print_summary(entries, args.gap)
@@ -0,0 +1,183 @@
+#!/usr/bin/env python
+
+# Copyright (c) 2016, Intel Corporation. All rights reserved.
+#
+# Redistribution and use in source and binary forms, with or without
+# modification, are permitted provided that the following conditions are met:
+#
+# 1. Redistributions of source code must retain the above copyright notice,
+# this list of conditions and the following disclaimer.
+#
+# 2. Redistributions in binary form must reproduce the above copyright notice,
+# this list of conditions and the following disclaimer in the documentation
+# and/or other materials provided with the distribution.
+#
+# 3. Neither the name of the copyright holder nor the names of its contributors
+# may be used to endorse or promote products derived from this software without
+# specific prior written permission.
+#
+# THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+# AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+# IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+# ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+# LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+# CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+# SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+# INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+# CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+# ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+# POSSIBILITY OF SUCH DAMAGE.
+
+# Read the raw data records streamed on the raw data USB CDC-ACM port.
+#
+# Each record is framed as:
+#   0xA5 | length (1 byte) | record (length bytes)
+# where record is the timestamp followed by the sensor data, as stored in the
+# rawdata partition and as sent on the raw data IASP channel.
+#
+# The reader works on any tty, so a pty can stand in for the board:
+#   rawdata_usb_reader.py simulate          (prints the pty to read from)
+#   rawdata_usb_reader.py read /dev/pts/N --csv
+
+import os
+import sys
+import pty
+import tty
+import time
+import argparse
+from struct import *
+
+from dump_rawdata import decode_data, decode_data_sandbox, set_wallclock
+
+RAWDATA_USB_SYNC = 0xA5
+
+def open_port(path):
+    fd = os.open(path, os.O_RDWR | os.O_NOCTTY)
+    # No echo nor line processing on the data
+    tty.setraw(fd)
+    return fd
+
+def read_exact(fd, size):
+    data = b''
+    while len(data) < size:
+        chunk = os.read(fd, size - len(data))
+        if not chunk:
+            raise EOFError
+        data += chunk
+    return data
+
+def read_records(fd):
+    # Yield the records, resynchronizing on the start of frame marker
+    lost = 0
+    while True:
+        sync = unpack('<B', read_exact(fd, 1))[0]
+        if sync != RAWDATA_USB_SYNC:
+            lost = lost + 1
+            continue
+        if lost:
+            print "WARNING: %d bytes skipped before start of frame"%lost
+            lost = 0
+        length = unpack('<B', read_exact(fd, 1))[0]
+        yield read_exact(fd, length)
+
+def read(args):
+    fd = open_port(args.port)
+    print 'Reading raw data from ' + args.port
+
+    frequency = int(args.frequency)
+    if args.csv == True:
+        fd_csv = open(args.files_header + '_data.csv', "wb")
+        fd_csv.write("Timestamp;T;<val>\n")
+        fd_csv_sandbox = open(args.files_header + '_snor.csv', "wb")
+        fd_csv_sandbox.write("Timestamp,AccelerometerX,AccelerometerY,AccelerometerZ,GyroscopeX,GyroscopeY,GyroscopeZ\n")
+
+    fd_bin = open(args.files_header + '_data.bin', "wb")
+    nb_records = 0
+    nb_bytes = 0
+    first_timestamp = 0
+    last_timestamp = 0
+    start = time.time()
+    try:
+        for record in read_records(fd):
+            timestamp = unpack('<I', record[0:4])[0]
+            if nb_records == 0:
+                first_timestamp = timestamp
+            last_timestamp = timestamp
+            nb_records = nb_records + 1
+            nb_bytes = nb_bytes + len(record)
+            fd_bin.write(record)
+            if args.csv == True:
+                decode_data(record, len(record), fd_csv)
+                decode_data_sandbox(record, len(record), frequency, fd_csv_sandbox)
+            if args.count and nb_records >= args.count:
+                break
+    except (EOFError, KeyboardInterrupt, OSError):
+        pass
+
+    duration = time.time() - start
+    print "Number of records received: %d"%(nb_records)
+    print "    First Time stamp: %d"%(first_timestamp)
+    print "    Last Time stamp : %d"%(last_timestamp)
+    if duration > 0:
+        print "    Throughput: %d bytes/s"%(nb_bytes / duration)
+    fd_bin.close()
+    if args.csv == True:
+        fd_csv.close()
+        fd_csv_sandbox.close()
+
+def simulate(args):
+    # Stand-in for the board: stream accel and gyro records on a pty
+    master, slave = pty.openpty()
+    tty.setraw(slave)
+    print 'Streaming simulated raw data on ' + os.ttyname(slave)
+    sys.stdout.flush()
+
+    interval = 1000 / int(args.frequency)
+    timestamp = 0
+    nb_records = 0
+    try:
+        while not args.count or nb_records < args.count:
+            record = pack('<I', timestamp)
+            # 5 accel and 5 gyro samples per record
+            record += pack('<BB', 1, 5 * 6)
+            for i in range(5):
+                record += pack('<hhh', i, -i, 1000)
+            record += pack('<BB', 2, 5 * 12)
+            for i in range(5):
+                record += pack('<iii', i, -i, 0)
+            os.write(master, pack('<BB', RAWDATA_USB_SYNC, len(record)) + record)
+            timestamp = timestamp + 5 * interval
+            nb_records = nb_records + 1
+            time.sleep(5 * interval / 1000.0)
+        # Let the reader drain the pty before closing it
+        time.sleep(1)
+    except KeyboardInterrupt:
+        pass
+
+if __name__ == "__main__":
+
+    parser = argparse.ArgumentParser()
+    parser.add_argument('action', action='store', choices=['read', 'simulate'],
+                        help='read records from a port or simulate a board on a pty')
+    parser.add_argument('port', action='store', nargs='?',
+                        help='raw data CDC-ACM port (or pty) to read from')
+    parser.add_argument('-f', '--files_header', action='store', help='files header (stream by default)', default="stream")
+    parser.add_argument("-csv", "--csv", help="create csv file",
+                    action="store_true")
+    parser.add_argument('-freq', '--frequency', action='store', default=100,
+                        help='Sensor sampling rate frequency in Hz (100hz by default)')
+    parser.add_argument('-n', '--count', action='store', type=int, default=0,
+                        help='Number of records to read or simulate (unlimited by default)')
+    parser.add_argument('-w', '--wallclock', action='store_true',
+                        help='decode the timestamps as wall clock time in ms')
+
+    args = parser.parse_args()
+    set_wallclock(args.wallclock)
+
+    if args.action == 'simulate':
+        simulate(args)
+    elif args.port:
+        read(args)
+    else:
+        print 'A port is needed to read raw data'
+        exit(1)